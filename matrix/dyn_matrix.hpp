@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "kernels.hpp"
+
+template <typename T = int64_t>
+class DynMatrix {
+ private:
+  AlignedVector<T> data_;
+  size_t rows_ = 0;
+  size_t columns_ = 0;
+
+ public:
+  DynMatrix() = default;
+
+  DynMatrix(size_t rows, size_t columns, const T& elem = T())
+      : data_(rows * columns, elem), rows_(rows), columns_(columns) {}
+
+  DynMatrix(const std::vector<std::vector<T>>& mat)
+      : DynMatrix(mat.size(), mat.empty() ? 0 : mat[0].size()) {
+    for (size_t iii = 0; iii < rows_; ++iii) {
+      std::copy(mat[iii].begin(), mat[iii].end(), RowData(iii));
+    }
+  }
+
+  // Adopts a row-major buffer of exactly rows * columns elements.
+  DynMatrix(size_t rows, size_t columns, AlignedVector<T>&& data)
+      : data_(std::move(data)), rows_(rows), columns_(columns) {
+    if (data_.size() != rows * columns) {
+      throw std::invalid_argument("DynMatrix: buffer size mismatch");
+    }
+  }
+
+  // Deep copy of a (possibly strided) slice.
+  explicit DynMatrix(MatrixView<const T> view)
+      : DynMatrix(view.Rows(), view.Columns()) {
+    for (size_t iii = 0; iii < rows_; ++iii) {
+      std::copy(view.Data() + iii * view.Stride(),
+                view.Data() + iii * view.Stride() + columns_, RowData(iii));
+    }
+  }
+
+  size_t Rows() const { return rows_; }
+  size_t Columns() const { return columns_; }
+  size_t Stride() const { return columns_; }
+  T* Data() { return data_.data(); }
+  const T* Data() const { return data_.data(); }
+  T* RowData(size_t row) { return data_.data() + row * columns_; }
+  const T* RowData(size_t row) const { return data_.data() + row * columns_; }
+
+  MatrixView<T> View() { return {data_.data(), rows_, columns_, columns_}; }
+  MatrixView<const T> View() const {
+    return {data_.data(), rows_, columns_, columns_};
+  }
+
+  MatrixView<T> Block(size_t row, size_t column, size_t rows, size_t columns) {
+    return View().Block(row, column, rows, columns);
+  }
+  MatrixView<const T> Block(size_t row, size_t column, size_t rows,
+                            size_t columns) const {
+    return View().Block(row, column, rows, columns);
+  }
+
+  // Hands the storage over (e.g. to Matrix<N, M, T>) and leaves *this empty.
+  AlignedVector<T> Release() && {
+    rows_ = 0;
+    columns_ = 0;
+    return std::move(data_);
+  }
+
+  DynMatrix& operator+=(const DynMatrix& other) {
+    CheckSameShape(other);
+    matrix_kernels::Add(rows_, columns_, other.Data(), other.Stride(), Data(),
+                        Stride());
+    return *this;
+  }
+
+  DynMatrix operator+(const DynMatrix& other) const {
+    auto tmp = *this;
+    tmp += other;
+    return tmp;
+  }
+
+  DynMatrix& operator-=(const DynMatrix& other) {
+    CheckSameShape(other);
+    matrix_kernels::Sub(rows_, columns_, other.Data(), other.Stride(), Data(),
+                        Stride());
+    return *this;
+  }
+
+  DynMatrix operator-(const DynMatrix& other) const {
+    auto tmp = *this;
+    tmp -= other;
+    return tmp;
+  }
+
+  DynMatrix& operator*=(const T& elem) {
+    matrix_kernels::Scale(rows_, columns_, elem, Data(), Stride());
+    return *this;
+  }
+
+  bool operator==(const DynMatrix& other) const {
+    return rows_ == other.rows_ && columns_ == other.columns_ &&
+           data_ == other.data_;
+  }
+
+  bool operator!=(const DynMatrix& other) const { return !(*this == other); }
+
+  DynMatrix Transposed() const {
+    DynMatrix copy(columns_, rows_);
+    matrix_kernels::Transpose(rows_, columns_, Data(), Stride(), copy.Data(),
+                              copy.Stride());
+    return copy;
+  }
+
+  T& operator()(size_t row, size_t column) {
+    return data_[row * columns_ + column];
+  }
+
+  const T& operator()(size_t row, size_t column) const {
+    return data_[row * columns_ + column];
+  }
+
+ private:
+  void CheckSameShape(const DynMatrix& other) const {
+    if (rows_ != other.rows_ || columns_ != other.columns_) {
+      throw std::invalid_argument("DynMatrix: shape mismatch");
+    }
+  }
+};
+
+// result += first * second on arbitrary (possibly sliced) views.
+template <typename T>
+void MultiplyAdd(MatrixView<const T> first, MatrixView<const T> second,
+                 MatrixView<T> result) {
+  if (first.Columns() != second.Rows() || result.Rows() != first.Rows() ||
+      result.Columns() != second.Columns()) {
+    throw std::invalid_argument("MultiplyAdd: shape mismatch");
+  }
+  matrix_kernels::Gemm(first.Rows(), first.Columns(), second.Columns(),
+                       first.Data(), first.Stride(), second.Data(),
+                       second.Stride(), result.Data(), result.Stride());
+}
+
+template <typename T>
+DynMatrix<T> operator*(const DynMatrix<T>& first, const DynMatrix<T>& second) {
+  DynMatrix<T> copy(first.Rows(), second.Columns());
+  MultiplyAdd(first.View(), second.View(), copy.View());
+  return copy;
+}
+
+template <typename T>
+DynMatrix<T> operator*(const DynMatrix<T>& first, const T& elem) {
+  DynMatrix<T> copy = first;
+  copy *= elem;
+  return copy;
+}
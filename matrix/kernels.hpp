@@ -0,0 +1,439 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>& /*other*/) {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(
+        ::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T* ptr, size_t /*count*/) {
+    ::operator delete(ptr, std::align_val_t(Alignment));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>& /*other*/) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment>& /*other*/) const {
+    return false;
+  }
+};
+
+// Storage shared by Matrix and DynMatrix, so that a buffer can be handed over
+// between the two without copying.
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Non-owning row-major window into a matrix: element (i, j) lives at
+// data[i * stride + j]. Slicing with Block() never copies.
+template <typename T>
+class MatrixView {
+ private:
+  T* data_ = nullptr;
+  size_t rows_ = 0;
+  size_t columns_ = 0;
+  size_t stride_ = 0;
+
+ public:
+  MatrixView() = default;
+
+  MatrixView(T* data, size_t rows, size_t columns, size_t stride)
+      : data_(data), rows_(rows), columns_(columns), stride_(stride) {}
+
+  template <typename U>
+  MatrixView(const MatrixView<U>& other)
+      : data_(other.Data()),
+        rows_(other.Rows()),
+        columns_(other.Columns()),
+        stride_(other.Stride()) {}
+
+  size_t Rows() const { return rows_; }
+  size_t Columns() const { return columns_; }
+  size_t Stride() const { return stride_; }
+  T* Data() const { return data_; }
+
+  T& operator()(size_t row, size_t column) const {
+    return data_[row * stride_ + column];
+  }
+
+  MatrixView Block(size_t row, size_t column, size_t rows,
+                   size_t columns) const {
+    return MatrixView(data_ + row * stride_ + column, rows, columns, stride_);
+  }
+};
+
+// Reduction policies for products that must stay inside a ring, e.g.
+// Matrix<N, N, T>::Pow.
+struct NoReduction {};
+
+// Arithmetic modulo `modulus` (1 <= modulus < 2^63) for integral T.
+template <typename T>
+struct ModularReduction {
+  T modulus;
+};
+
+namespace matrix_kernels {
+
+// Tile sizes of the blocked kernels: a kGemmBlockK x kGemmBlockCols panel of
+// B together with a row of C fits comfortably in L2 for 8-byte elements.
+const size_t kGemmBlockRows = 64;
+const size_t kGemmBlockCols = 256;
+const size_t kGemmBlockK = 128;
+const size_t kTransposeBlock = 32;
+// Matrices gathered per structure-of-arrays chunk in GemmBatch; one chunk of
+// 6 x 6 double operands and result stays within L1.
+const size_t kBatchLanes = 32;
+// Work items (about one multiply-add each) that every started thread must
+// get. Starting and joining a std::thread costs 10-30 us, while the kernels
+// split this way (GEMV, SpMV, SpMM) stream roughly one 8-byte item per ns
+// from DRAM, so 2^18 items keep the start-up near a tenth of a thread's
+// run. matrix_bench prints both numbers for the machine.
+const size_t kParallelGrain = size_t(1) << 18;
+
+inline size_t WorkerCount() {
+  size_t threads = std::thread::hardware_concurrency();
+  return threads == 0 ? 1 : threads;
+}
+
+// Threads worth using for `work` items: one per kParallelGrain, at least
+// one and at most one per core.
+inline size_t ThreadsFor(size_t work) {
+  return std::max<size_t>(1, std::min(WorkerCount(), work / kParallelGrain));
+}
+
+// Runs fn(bounds[t], bounds[t + 1]) for every non-empty range, one thread
+// per range; the calling thread takes the first one.
+template <typename Fn>
+void ParallelRanges(const std::vector<size_t>& bounds, Fn fn) {
+  std::vector<std::thread> workers;
+  for (size_t ttt = 1; ttt + 1 < bounds.size(); ++ttt) {
+    if (bounds[ttt] != bounds[ttt + 1]) {
+      workers.emplace_back(fn, bounds[ttt], bounds[ttt + 1]);
+    }
+  }
+  if (bounds.size() > 1 && bounds[0] != bounds[1]) {
+    fn(bounds[0], bounds[1]);
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+// Runs fn(begin, end) over equal slices of [0, count), where every item
+// costs about `item_work` multiply-adds.
+template <typename Fn>
+void ParallelFor(size_t count, Fn fn, size_t item_work = 1) {
+  size_t threads =
+      std::min(ThreadsFor(count * item_work), std::max<size_t>(count, 1));
+  std::vector<size_t> bounds(threads + 1);
+  for (size_t ttt = 0; ttt <= threads; ++ttt) {
+    bounds[ttt] = count * ttt / threads;
+  }
+  ParallelRanges(bounds, fn);
+}
+
+// Like ParallelFor, but balances the slices by weight: prefix[i] is the total
+// weight of items [0, i), e.g. a CSR row pointer balanced by non-zeros.
+template <typename Fn>
+void ParallelForWeighted(const std::vector<size_t>& prefix, Fn fn) {
+  size_t count = prefix.size() - 1;
+  size_t total = prefix.back() - prefix.front();
+  size_t threads =
+      std::min(ThreadsFor(total + count), std::max<size_t>(count, 1));
+  std::vector<size_t> bounds(threads + 1, count);
+  bounds[0] = 0;
+  for (size_t ttt = 1; ttt < threads; ++ttt) {
+    size_t target = prefix.front() + total * ttt / threads;
+    bounds[ttt] = std::lower_bound(prefix.begin(), prefix.end(), target) -
+                  prefix.begin();
+    bounds[ttt] = std::min(std::max(bounds[ttt], bounds[ttt - 1]), count);
+  }
+  ParallelRanges(bounds, fn);
+}
+
+// C[n x k] += A[n x m] * B[m x k] (or -= when `subtract` is set); lda, ldb
+// and ldc are row strides. Portable version for any T.
+template <typename T>
+void GemmUpdateGeneric(size_t n, size_t m, size_t k, const T* a, size_t lda,
+                       const T* b, size_t ldb, T* c, size_t ldc,
+                       bool subtract) {
+  for (size_t kk = 0; kk < m; kk += kGemmBlockK) {
+    size_t k_end = std::min(kk + kGemmBlockK, m);
+    for (size_t ii = 0; ii < n; ii += kGemmBlockRows) {
+      size_t i_end = std::min(ii + kGemmBlockRows, n);
+      for (size_t jj = 0; jj < k; jj += kGemmBlockCols) {
+        size_t j_end = std::min(jj + kGemmBlockCols, k);
+        for (size_t iii = ii; iii < i_end; ++iii) {
+          T* c_row = c + iii * ldc;
+          for (size_t ppp = kk; ppp < k_end; ++ppp) {
+            const T a_elem =
+                subtract ? -a[iii * lda + ppp] : a[iii * lda + ppp];
+            const T* b_row = b + ppp * ldb;
+            for (size_t jjj = jj; jjj < j_end; ++jjj) {
+              c_row[jjj] += a_elem * b_row[jjj];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Specialized for float and double in typed_kernels.hpp.
+template <typename T>
+void GemmUpdate(size_t n, size_t m, size_t k, const T* a, size_t lda,
+                const T* b, size_t ldb, T* c, size_t ldc, bool subtract) {
+  GemmUpdateGeneric(n, m, k, a, lda, b, ldb, c, ldc, subtract);
+}
+
+template <typename T>
+void Gemm(size_t n, size_t m, size_t k, const T* a, size_t lda, const T* b,
+          size_t ldb, T* c, size_t ldc) {
+  GemmUpdate(n, m, k, a, lda, b, ldb, c, ldc, false);
+}
+
+template <typename T>
+void GemmSub(size_t n, size_t m, size_t k, const T* a, size_t lda, const T* b,
+             size_t ldb, T* c, size_t ldc) {
+  GemmUpdate(n, m, k, a, lda, b, ldb, c, ldc, true);
+}
+
+// y[n] = A[n x m] * x[m]. Each row is a dot product split over four
+// partial sums so independent add chains overlap.
+template <typename T>
+void Gemv(size_t n, size_t m, const T* a, size_t lda, const T* x, T* y) {
+  auto rows = [&](size_t begin, size_t end) {
+    for (size_t iii = begin; iii < end; ++iii) {
+      const T* a_row = a + iii * lda;
+      T sum0 = T();
+      T sum1 = T();
+      T sum2 = T();
+      T sum3 = T();
+      size_t jjj = 0;
+      for (; jjj + 4 <= m; jjj += 4) {
+        sum0 += a_row[jjj] * x[jjj];
+        sum1 += a_row[jjj + 1] * x[jjj + 1];
+        sum2 += a_row[jjj + 2] * x[jjj + 2];
+        sum3 += a_row[jjj + 3] * x[jjj + 3];
+      }
+      for (; jjj < m; ++jjj) {
+        sum0 += a_row[jjj] * x[jjj];
+      }
+      y[iii] = (sum0 + sum1) + (sum2 + sum3);
+    }
+  };
+  // A 64 x 64 GEMV is 4096 multiply-adds, a few microseconds: far less
+  // than starting a thread, so rows are split only per kParallelGrain.
+  size_t threads = std::min(ThreadsFor(n * m), std::max<size_t>(n, 1));
+  std::vector<size_t> bounds(threads + 1);
+  for (size_t ttt = 0; ttt <= threads; ++ttt) {
+    bounds[ttt] = n * ttt / threads;
+  }
+  ParallelRanges(bounds, rows);
+}
+
+// C_l[n x k] += A_l[n x m] * B_l[m x k] for every l < lanes, in
+// structure-of-arrays layout: entry (i, j) of matrix l is at
+// a[(i * m + j) * lanes + l], and likewise for b and c. The innermost loop
+// runs across the batch, so it vectorizes even for 3 x 3 operands.
+template <typename T>
+void GemmBatch(size_t n, size_t m, size_t k, size_t lanes, const T* a,
+               const T* b, T* c) {
+  for (size_t iii = 0; iii < n; ++iii) {
+    for (size_t ppp = 0; ppp < m; ++ppp) {
+      const T* a_elem = a + (iii * m + ppp) * lanes;
+      for (size_t jjj = 0; jjj < k; ++jjj) {
+        const T* b_elem = b + (ppp * k + jjj) * lanes;
+        T* c_elem = c + (iii * k + jjj) * lanes;
+        for (size_t lll = 0; lll < lanes; ++lll) {
+          c_elem[lll] += a_elem[lll] * b_elem[lll];
+        }
+      }
+    }
+  }
+}
+
+// dst[cols x rows] = transpose(src[rows x cols]).
+template <typename T>
+void Transpose(size_t rows, size_t cols, const T* src, size_t lds, T* dst,
+               size_t ldd) {
+  for (size_t ii = 0; ii < rows; ii += kTransposeBlock) {
+    size_t i_end = std::min(ii + kTransposeBlock, rows);
+    for (size_t jj = 0; jj < cols; jj += kTransposeBlock) {
+      size_t j_end = std::min(jj + kTransposeBlock, cols);
+      for (size_t iii = ii; iii < i_end; ++iii) {
+        for (size_t jjj = jj; jjj < j_end; ++jjj) {
+          dst[jjj * ldd + iii] = src[iii * lds + jjj];
+        }
+      }
+    }
+  }
+}
+
+// dst(i, j) = op(dst(i, j), src(i, j)) over a rows x cols region.
+template <typename T, typename Op>
+void Elementwise(size_t rows, size_t cols, const T* src, size_t lds, T* dst,
+                 size_t ldd, Op op) {
+  for (size_t iii = 0; iii < rows; ++iii) {
+    const T* src_row = src + iii * lds;
+    T* dst_row = dst + iii * ldd;
+    for (size_t jjj = 0; jjj < cols; ++jjj) {
+      dst_row[jjj] = op(dst_row[jjj], src_row[jjj]);
+    }
+  }
+}
+
+template <typename T>
+void Add(size_t rows, size_t cols, const T* src, size_t lds, T* dst,
+         size_t ldd) {
+  Elementwise(rows, cols, src, lds, dst, ldd,
+              [](const T& lhs, const T& rhs) { return lhs + rhs; });
+}
+
+template <typename T>
+void Sub(size_t rows, size_t cols, const T* src, size_t lds, T* dst,
+         size_t ldd) {
+  Elementwise(rows, cols, src, lds, dst, ldd,
+              [](const T& lhs, const T& rhs) { return lhs - rhs; });
+}
+
+template <typename T>
+void Scale(size_t rows, size_t cols, const T& elem, T* dst, size_t ldd) {
+  for (size_t iii = 0; iii < rows; ++iii) {
+    T* dst_row = dst + iii * ldd;
+    for (size_t jjj = 0; jjj < cols; ++jjj) {
+      dst_row[jjj] *= elem;
+    }
+  }
+}
+
+template <typename T>
+void Fill(size_t rows, size_t cols, const T& elem, T* dst, size_t ldd) {
+  for (size_t iii = 0; iii < rows; ++iii) {
+    std::fill(dst + iii * ldd, dst + iii * ldd + cols, elem);
+  }
+}
+
+template <typename T>
+bool Equal(size_t rows, size_t cols, const T* lhs, size_t ldl, const T* rhs,
+           size_t ldr) {
+  for (size_t iii = 0; iii < rows; ++iii) {
+    if (!std::equal(lhs + iii * ldl, lhs + iii * ldl + cols, rhs + iii * ldr)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// C[n x k] = A[n x m] * B[m x k] mod `modulus` for entries already in
+// [0, modulus). Products are summed in an unsigned accumulator and reduced
+// only every `limit` terms, just before the accumulator could overflow.
+template <typename Acc, typename T>
+void GemmModImpl(size_t n, size_t m, size_t k, const T* a, size_t lda,
+                 const T* b, size_t ldb, T* c, size_t ldc, uint64_t modulus) {
+  const Acc largest = static_cast<Acc>(modulus - 1);
+  const Acc max_term = largest * largest;
+  Acc limit = max_term == 0 ? Acc(m) : (~Acc(0) - largest) / max_term;
+  size_t reduce_every =
+      limit >= static_cast<Acc>(m) || m == 0 ? m : static_cast<size_t>(limit);
+  std::vector<Acc> acc(k);
+  for (size_t iii = 0; iii < n; ++iii) {
+    std::fill(acc.begin(), acc.end(), Acc(0));
+    size_t pending = 0;
+    for (size_t ppp = 0; ppp < m; ++ppp) {
+      const Acc a_elem = static_cast<Acc>(a[iii * lda + ppp]);
+      if (a_elem == 0) {
+        continue;
+      }
+      const T* b_row = b + ppp * ldb;
+      for (size_t jjj = 0; jjj < k; ++jjj) {
+        acc[jjj] += a_elem * static_cast<Acc>(b_row[jjj]);
+      }
+      if (++pending == reduce_every) {
+        for (size_t jjj = 0; jjj < k; ++jjj) {
+          acc[jjj] %= modulus;
+        }
+        pending = 0;
+      }
+    }
+    for (size_t jjj = 0; jjj < k; ++jjj) {
+      c[iii * ldc + jjj] = static_cast<T>(acc[jjj] % modulus);
+    }
+  }
+}
+
+template <typename T>
+void GemmMod(size_t n, size_t m, size_t k, const T* a, size_t lda, const T* b,
+             size_t ldb, T* c, size_t ldc, uint64_t modulus) {
+  if (modulus <= (uint64_t(1) << 32)) {
+    GemmModImpl<uint64_t>(n, m, k, a, lda, b, ldb, c, ldc, modulus);
+  } else {
+    GemmModImpl<unsigned __int128>(n, m, k, a, lda, b, ldb, c, ldc, modulus);
+  }
+}
+
+// c = a * b for n x n row-major buffers under a reduction policy.
+template <typename T>
+void MultiplyInto(const NoReduction& /*policy*/, size_t n, const T* a,
+                  const T* b, T* c) {
+  Fill(n, n, T(), c, n);
+  Gemm(n, n, n, a, n, b, n, c, n);
+}
+
+template <typename T>
+void MultiplyInto(const ModularReduction<T>& policy, size_t n, const T* a,
+                  const T* b, T* c) {
+  GemmMod(n, n, n, a, n, b, n, c, n, static_cast<uint64_t>(policy.modulus));
+}
+
+// Throws std::invalid_argument for a policy the kernels cannot work with.
+inline void Validate(const NoReduction& /*policy*/) {}
+
+template <typename T>
+void Validate(const ModularReduction<T>& policy) {
+  if (!(policy.modulus > T())) {
+    throw std::invalid_argument("ModularReduction: modulus must be positive");
+  }
+}
+
+// Brings arbitrary entries into the range the policy works in.
+template <typename T>
+void Reduce(const NoReduction& /*policy*/, size_t /*count*/, T* /*data*/) {}
+
+template <typename T>
+void Reduce(const ModularReduction<T>& policy, size_t count, T* data) {
+  for (size_t iii = 0; iii < count; ++iii) {
+    data[iii] %= policy.modulus;
+    if (data[iii] < T()) {
+      data[iii] += policy.modulus;
+    }
+  }
+}
+
+}  // namespace matrix_kernels
+
+// Element-type specific kernels (SIMD float/double, widening integer GEMM).
+#include "typed_kernels.hpp"
@@ -0,0 +1,596 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "dyn_matrix.hpp"
+#include "kernels.hpp"
+
+// Dense factorizations for floating-point T. Every algorithm works on panels
+// of kPanelWidth columns: the panel itself is factored with level-2 loops and
+// the (much larger) trailing update goes through matrix_kernels::Gemm.
+
+namespace linalg_detail {
+
+const size_t kPanelWidth = 64;
+
+template <typename T>
+T Abs(const T& value) {
+  return value < T() ? -value : value;
+}
+
+// row[0, count) -= factor * src[0, count)
+template <typename T>
+void SubScaledRow(size_t count, const T& factor, const T* src, T* row) {
+  for (size_t jjj = 0; jjj < count; ++jjj) {
+    row[jjj] -= factor * src[jjj];
+  }
+}
+
+// rhs = lower^{-1} * rhs for a lower-triangular `lower` (n x n).
+template <typename T>
+void SolveLower(MatrixView<const T> lower, bool unit_diagonal,
+                MatrixView<T> rhs) {
+  size_t n = lower.Rows();
+  size_t k = rhs.Columns();
+  for (size_t k0 = 0; k0 < n; k0 += kPanelWidth) {
+    size_t k1 = std::min(k0 + kPanelWidth, n);
+    for (size_t iii = k0; iii < k1; ++iii) {
+      T* row = &rhs(iii, 0);
+      for (size_t ppp = k0; ppp < iii; ++ppp) {
+        SubScaledRow(k, lower(iii, ppp), &rhs(ppp, 0), row);
+      }
+      if (!unit_diagonal) {
+        const T diag = lower(iii, iii);
+        for (size_t jjj = 0; jjj < k; ++jjj) {
+          row[jjj] /= diag;
+        }
+      }
+    }
+    if (k1 < n) {
+      matrix_kernels::GemmSub(n - k1, k1 - k0, k, &lower(k1, k0),
+                              lower.Stride(), &rhs(k0, 0), rhs.Stride(),
+                              &rhs(k1, 0), rhs.Stride());
+    }
+  }
+}
+
+// rhs = upper^{-1} * rhs for an upper-triangular `upper` (n x n); entries
+// below the diagonal are never read.
+template <typename T>
+void SolveUpper(MatrixView<const T> upper, MatrixView<T> rhs) {
+  size_t n = upper.Rows();
+  size_t k = rhs.Columns();
+  for (size_t k1 = n; k1 > 0;) {
+    size_t k0 = k1 > kPanelWidth ? k1 - kPanelWidth : 0;
+    for (size_t iii = k1; iii-- > k0;) {
+      T* row = &rhs(iii, 0);
+      for (size_t ppp = iii + 1; ppp < k1; ++ppp) {
+        SubScaledRow(k, upper(iii, ppp), &rhs(ppp, 0), row);
+      }
+      const T diag = upper(iii, iii);
+      for (size_t jjj = 0; jjj < k; ++jjj) {
+        row[jjj] /= diag;
+      }
+    }
+    if (k0 > 0) {
+      matrix_kernels::GemmSub(k0, k1 - k0, k, &upper(0, k0), upper.Stride(),
+                              &rhs(k0, 0), rhs.Stride(), &rhs(0, 0),
+                              rhs.Stride());
+    }
+    k1 = k0;
+  }
+}
+
+template <typename T>
+DynMatrix<T> Identity(size_t size) {
+  DynMatrix<T> identity(size, size);
+  for (size_t iii = 0; iii < size; ++iii) {
+    identity(iii, iii) = T(1);
+  }
+  return identity;
+}
+
+}  // namespace linalg_detail
+
+// PA = LU with partial (row) pivoting, blocked right-looking.
+template <typename T>
+class LuDecomposition {
+ private:
+  // Unit lower-triangular L strictly below the diagonal, U on and above it.
+  DynMatrix<T> packed_;
+  // Row i of PA is row permutation_[i] of A.
+  std::vector<size_t> permutation_;
+  int sign_ = 1;
+  bool singular_ = false;
+
+ public:
+  explicit LuDecomposition(DynMatrix<T> matrix)
+    requires std::is_floating_point_v<T>
+      : packed_(std::move(matrix)) {
+    if (packed_.Rows() != packed_.Columns()) {
+      throw std::invalid_argument("LuDecomposition: matrix must be square");
+    }
+    Factor();
+  }
+
+  bool IsSingular() const { return singular_; }
+  const DynMatrix<T>& Packed() const { return packed_; }
+  const std::vector<size_t>& Permutation() const { return permutation_; }
+
+  T Determinant() const {
+    if (singular_) {
+      return T();
+    }
+    T det = sign_ < 0 ? T(-1) : T(1);
+    for (size_t iii = 0; iii < packed_.Rows(); ++iii) {
+      det *= packed_(iii, iii);
+    }
+    return det;
+  }
+
+  // rhs = A^{-1} * rhs for any number of right-hand-side columns.
+  void SolveInPlace(MatrixView<T> rhs) const {
+    if (singular_) {
+      throw std::runtime_error("LuDecomposition: matrix is singular");
+    }
+    if (rhs.Rows() != packed_.Rows()) {
+      throw std::invalid_argument("LuDecomposition: shape mismatch");
+    }
+    DynMatrix<T> permuted(rhs.Rows(), rhs.Columns());
+    for (size_t iii = 0; iii < rhs.Rows(); ++iii) {
+      const T* src = &rhs(permutation_[iii], 0);
+      std::copy(src, src + rhs.Columns(), permuted.RowData(iii));
+    }
+    linalg_detail::SolveLower(packed_.View(), true, permuted.View());
+    linalg_detail::SolveUpper(packed_.View(), permuted.View());
+    for (size_t iii = 0; iii < rhs.Rows(); ++iii) {
+      std::copy(permuted.RowData(iii), permuted.RowData(iii) + rhs.Columns(),
+                &rhs(iii, 0));
+    }
+  }
+
+  DynMatrix<T> Solve(const DynMatrix<T>& rhs) const {
+    DynMatrix<T> result = rhs;
+    SolveInPlace(result.View());
+    return result;
+  }
+
+  std::vector<T> Solve(const std::vector<T>& rhs) const {
+    std::vector<T> result = rhs;
+    SolveInPlace(MatrixView<T>(result.data(), result.size(), 1, 1));
+    return result;
+  }
+
+  DynMatrix<T> Inverse() const {
+    DynMatrix<T> result = linalg_detail::Identity<T>(packed_.Rows());
+    SolveInPlace(result.View());
+    return result;
+  }
+
+ private:
+  void Factor() {
+    size_t n = packed_.Rows();
+    MatrixView<T> lu = packed_.View();
+    permutation_.resize(n);
+    for (size_t iii = 0; iii < n; ++iii) {
+      permutation_[iii] = iii;
+    }
+    for (size_t k0 = 0; k0 < n; k0 += linalg_detail::kPanelWidth) {
+      size_t k1 = std::min(k0 + linalg_detail::kPanelWidth, n);
+      FactorPanel(k0, k1);
+      if (k1 == n) {
+        break;
+      }
+      // U12 = L11^{-1} A12, then A22 -= L21 * U12.
+      linalg_detail::SolveLower<T>(lu.Block(k0, k0, k1 - k0, k1 - k0), true,
+                                   lu.Block(k0, k1, k1 - k0, n - k1));
+      matrix_kernels::GemmSub(n - k1, k1 - k0, n - k1, &lu(k1, k0),
+                              lu.Stride(), &lu(k0, k1), lu.Stride(),
+                              &lu(k1, k1), lu.Stride());
+    }
+  }
+
+  // Unblocked elimination of columns [k0, k1) over rows [k0, n); row swaps
+  // are applied to whole rows, so L to the left is permuted as well.
+  void FactorPanel(size_t k0, size_t k1) {
+    size_t n = packed_.Rows();
+    MatrixView<T> lu = packed_.View();
+    for (size_t jjj = k0; jjj < k1; ++jjj) {
+      size_t pivot = jjj;
+      for (size_t iii = jjj + 1; iii < n; ++iii) {
+        if (linalg_detail::Abs(lu(iii, jjj)) >
+            linalg_detail::Abs(lu(pivot, jjj))) {
+          pivot = iii;
+        }
+      }
+      if (pivot != jjj) {
+        std::swap_ranges(&lu(jjj, 0), &lu(jjj, 0) + n, &lu(pivot, 0));
+        std::swap(permutation_[jjj], permutation_[pivot]);
+        sign_ = -sign_;
+      }
+      if (lu(jjj, jjj) == T()) {
+        singular_ = true;
+        continue;
+      }
+      const T diag = lu(jjj, jjj);
+      for (size_t iii = jjj + 1; iii < n; ++iii) {
+        lu(iii, jjj) /= diag;
+        linalg_detail::SubScaledRow(k1 - jjj - 1, lu(iii, jjj),
+                                    &lu(jjj, jjj + 1), &lu(iii, jjj + 1));
+      }
+    }
+  }
+};
+
+// A = L L^T for symmetric positive definite A, blocked right-looking.
+template <typename T>
+class CholeskyDecomposition {
+ private:
+  DynMatrix<T> lower_;
+  // lower_ transposed, so that both triangular solves run along rows.
+  DynMatrix<T> upper_;
+
+ public:
+  // Throws std::domain_error when A is not positive definite. Only the lower
+  // triangle of A is read.
+  explicit CholeskyDecomposition(DynMatrix<T> matrix)
+    requires std::is_floating_point_v<T>
+      : lower_(std::move(matrix)) {
+    if (lower_.Rows() != lower_.Columns()) {
+      throw std::invalid_argument(
+          "CholeskyDecomposition: matrix must be square");
+    }
+    Factor();
+    upper_ = lower_.Transposed();
+  }
+
+  const DynMatrix<T>& L() const { return lower_; }
+
+  T Determinant() const {
+    T det = T(1);
+    for (size_t iii = 0; iii < lower_.Rows(); ++iii) {
+      det *= lower_(iii, iii) * lower_(iii, iii);
+    }
+    return det;
+  }
+
+  void SolveInPlace(MatrixView<T> rhs) const {
+    if (rhs.Rows() != lower_.Rows()) {
+      throw std::invalid_argument("CholeskyDecomposition: shape mismatch");
+    }
+    linalg_detail::SolveLower(lower_.View(), false, rhs);
+    linalg_detail::SolveUpper(upper_.View(), rhs);
+  }
+
+  DynMatrix<T> Solve(const DynMatrix<T>& rhs) const {
+    DynMatrix<T> result = rhs;
+    SolveInPlace(result.View());
+    return result;
+  }
+
+  std::vector<T> Solve(const std::vector<T>& rhs) const {
+    std::vector<T> result = rhs;
+    SolveInPlace(MatrixView<T>(result.data(), result.size(), 1, 1));
+    return result;
+  }
+
+  DynMatrix<T> Inverse() const {
+    DynMatrix<T> result = linalg_detail::Identity<T>(lower_.Rows());
+    SolveInPlace(result.View());
+    return result;
+  }
+
+ private:
+  void Factor() {
+    size_t n = lower_.Rows();
+    MatrixView<T> a = lower_.View();
+    for (size_t k0 = 0; k0 < n; k0 += linalg_detail::kPanelWidth) {
+      size_t k1 = std::min(k0 + linalg_detail::kPanelWidth, n);
+      // Panel [k0, n) x [k0, k1): the diagonal block and L21 together.
+      for (size_t jjj = k0; jjj < k1; ++jjj) {
+        T diag = a(jjj, jjj);
+        for (size_t ppp = k0; ppp < jjj; ++ppp) {
+          diag -= a(jjj, ppp) * a(jjj, ppp);
+        }
+        if (!(diag > T())) {
+          throw std::domain_error(
+              "CholeskyDecomposition: matrix is not positive definite");
+        }
+        diag = std::sqrt(diag);
+        a(jjj, jjj) = diag;
+        for (size_t iii = jjj + 1; iii < n; ++iii) {
+          T sum = a(iii, jjj);
+          for (size_t ppp = k0; ppp < jjj; ++ppp) {
+            sum -= a(iii, ppp) * a(jjj, ppp);
+          }
+          a(iii, jjj) = sum / diag;
+        }
+      }
+      if (k1 == n) {
+        break;
+      }
+      // A22 -= L21 * L21^T, one block row at a time and only up to the
+      // diagonal, so the upper triangle costs nothing.
+      size_t rest = n - k1;
+      DynMatrix<T> panel_t(k1 - k0, rest);
+      matrix_kernels::Transpose(rest, k1 - k0, &a(k1, k0), a.Stride(),
+                                panel_t.Data(), panel_t.Stride());
+      for (size_t ib = k1; ib < n; ib += linalg_detail::kPanelWidth) {
+        size_t ie = std::min(ib + linalg_detail::kPanelWidth, n);
+        matrix_kernels::GemmSub(ie - ib, k1 - k0, ie - k1, &a(ib, k0),
+                                a.Stride(), panel_t.Data(), panel_t.Stride(),
+                                &a(ib, k1), a.Stride());
+      }
+    }
+    for (size_t iii = 0; iii < n; ++iii) {
+      std::fill(&a(iii, 0) + iii + 1, &a(iii, 0) + n, T());
+    }
+  }
+};
+
+// A = QR with Householder reflections for rows >= columns. Each panel of
+// reflectors is kept in compact WY form Q_k = I - V T V^T, so applying Q^T
+// to the trailing matrix or to right-hand sides is three GEMMs.
+template <typename T>
+class QrDecomposition {
+ private:
+  // R on and above the diagonal; reflector vectors below it (their leading
+  // 1 is implied).
+  DynMatrix<T> packed_;
+  std::vector<T> tau_;
+  // Upper-triangular T factor of every panel.
+  std::vector<DynMatrix<T>> block_factors_;
+
+ public:
+  explicit QrDecomposition(DynMatrix<T> matrix)
+    requires std::is_floating_point_v<T>
+      : packed_(std::move(matrix)) {
+    if (packed_.Rows() < packed_.Columns()) {
+      throw std::invalid_argument(
+          "QrDecomposition: matrix must have rows >= columns");
+    }
+    Factor();
+  }
+
+  DynMatrix<T> R() const {
+    size_t n = packed_.Columns();
+    DynMatrix<T> result(n, n);
+    for (size_t iii = 0; iii < n; ++iii) {
+      std::copy(packed_.RowData(iii) + iii, packed_.RowData(iii) + n,
+                result.RowData(iii) + iii);
+    }
+    return result;
+  }
+
+  // Determinant of a square A: every non-trivial reflector flips the sign.
+  T Determinant() const {
+    T det = T(1);
+    for (size_t iii = 0; iii < packed_.Columns(); ++iii) {
+      det *= packed_(iii, iii);
+      if (tau_[iii] != T()) {
+        det = -det;
+      }
+    }
+    return det;
+  }
+
+  // rhs = Q^T * rhs, where rhs has as many rows as A.
+  void ApplyQt(MatrixView<T> rhs) const {
+    if (rhs.Rows() != packed_.Rows()) {
+      throw std::invalid_argument("QrDecomposition: shape mismatch");
+    }
+    size_t n = packed_.Columns();
+    for (size_t k0 = 0, panel = 0; k0 < n;
+         k0 += linalg_detail::kPanelWidth, ++panel) {
+      size_t k1 = std::min(k0 + linalg_detail::kPanelWidth, n);
+      ApplyBlockReflector(k0, k1, block_factors_[panel],
+                          rhs.Block(k0, 0, rhs.Rows() - k0, rhs.Columns()));
+    }
+  }
+
+  // Least-squares solution of A x = rhs (exact when A is square).
+  DynMatrix<T> Solve(const DynMatrix<T>& rhs) const {
+    DynMatrix<T> work = rhs;
+    ApplyQt(work.View());
+    size_t n = packed_.Columns();
+    for (size_t iii = 0; iii < n; ++iii) {
+      if (packed_(iii, iii) == T()) {
+        throw std::runtime_error("QrDecomposition: matrix is rank deficient");
+      }
+    }
+    DynMatrix<T> result(work.Block(0, 0, n, work.Columns()));
+    linalg_detail::SolveUpper(packed_.Block(0, 0, n, n), result.View());
+    return result;
+  }
+
+  std::vector<T> Solve(const std::vector<T>& rhs) const {
+    DynMatrix<T> solution =
+        Solve(DynMatrix<T>(MatrixView<const T>(rhs.data(), rhs.size(), 1, 1)));
+    return std::vector<T>(solution.Data(),
+                          solution.Data() + solution.Rows());
+  }
+
+ private:
+  void Factor() {
+    size_t n = packed_.Columns();
+    tau_.assign(n, T());
+    for (size_t k0 = 0; k0 < n; k0 += linalg_detail::kPanelWidth) {
+      size_t k1 = std::min(k0 + linalg_detail::kPanelWidth, n);
+      FactorPanel(k0, k1);
+      block_factors_.push_back(BlockFactor(k0, k1));
+      if (k1 < n) {
+        ApplyBlockReflector(
+            k0, k1, block_factors_.back(),
+            packed_.Block(k0, k1, packed_.Rows() - k0, n - k1));
+      }
+    }
+  }
+
+  void FactorPanel(size_t k0, size_t k1) {
+    size_t m = packed_.Rows();
+    MatrixView<T> a = packed_.View();
+    std::vector<T> work(k1 - k0);
+    for (size_t jjj = k0; jjj < k1; ++jjj) {
+      // Reflector H = I - tau v v^T with v[0] = 1 and H x = (beta, 0, ...).
+      T sigma = T();
+      for (size_t iii = jjj + 1; iii < m; ++iii) {
+        sigma += a(iii, jjj) * a(iii, jjj);
+      }
+      if (sigma == T()) {
+        continue;
+      }
+      const T alpha = a(jjj, jjj);
+      T norm = std::sqrt(alpha * alpha + sigma);
+      const T beta = alpha > T() ? -norm : norm;
+      const T tau = (beta - alpha) / beta;
+      const T scale = T(1) / (alpha - beta);
+      for (size_t iii = jjj + 1; iii < m; ++iii) {
+        a(iii, jjj) *= scale;
+      }
+      a(jjj, jjj) = beta;
+      tau_[jjj] = tau;
+
+      // Apply H to the rest of the panel: w = tau * v^T A, A -= v w.
+      size_t width = k1 - jjj - 1;
+      std::copy(&a(jjj, jjj + 1), &a(jjj, jjj + 1) + width, work.begin());
+      for (size_t iii = jjj + 1; iii < m; ++iii) {
+        const T vi = a(iii, jjj);
+        const T* row = &a(iii, jjj + 1);
+        for (size_t ccc = 0; ccc < width; ++ccc) {
+          work[ccc] += vi * row[ccc];
+        }
+      }
+      for (size_t ccc = 0; ccc < width; ++ccc) {
+        work[ccc] *= tau;
+      }
+      linalg_detail::SubScaledRow(width, T(1), work.data(), &a(jjj, jjj + 1));
+      for (size_t iii = jjj + 1; iii < m; ++iii) {
+        linalg_detail::SubScaledRow(width, a(iii, jjj), work.data(),
+                                    &a(iii, jjj + 1));
+      }
+    }
+  }
+
+  // Explicit V (rows [k0, m), unit diagonal, zeros above) of a panel.
+  DynMatrix<T> Reflectors(size_t k0, size_t k1) const {
+    size_t rows = packed_.Rows() - k0;
+    size_t width = k1 - k0;
+    DynMatrix<T> v(rows, width);
+    for (size_t iii = 0; iii < rows; ++iii) {
+      for (size_t jjj = 0; jjj < width && jjj <= iii; ++jjj) {
+        v(iii, jjj) = iii == jjj ? T(1) : packed_(k0 + iii, k0 + jjj);
+      }
+    }
+    return v;
+  }
+
+  // T with H_k0 ... H_k1-1 = I - V T V^T (LAPACK larft, forward/columnwise).
+  DynMatrix<T> BlockFactor(size_t k0, size_t k1) const {
+    size_t width = k1 - k0;
+    DynMatrix<T> v = Reflectors(k0, k1);
+    DynMatrix<T> gram = v.Transposed() * v;
+    DynMatrix<T> factor(width, width);
+    for (size_t jjj = 0; jjj < width; ++jjj) {
+      const T tau = tau_[k0 + jjj];
+      factor(jjj, jjj) = tau;
+      for (size_t rrr = 0; rrr < jjj; ++rrr) {
+        T sum = T();
+        for (size_t sss = rrr; sss < jjj; ++sss) {
+          sum += factor(rrr, sss) * gram(sss, jjj);
+        }
+        factor(rrr, jjj) = -tau * sum;
+      }
+    }
+    return factor;
+  }
+
+  // target = (I - V T V^T)^T target = target - V (T^T (V^T target)).
+  void ApplyBlockReflector(size_t k0, size_t k1, const DynMatrix<T>& factor,
+                           MatrixView<T> target) const {
+    DynMatrix<T> v = Reflectors(k0, k1);
+    DynMatrix<T> vt = v.Transposed();
+    DynMatrix<T> projected(k1 - k0, target.Columns());
+    MultiplyAdd<T>(vt.View(), target, projected.View());
+    DynMatrix<T> scaled = factor.Transposed() * projected;
+    matrix_kernels::GemmSub(v.Rows(), v.Columns(), target.Columns(), v.Data(),
+                            v.Stride(), scaled.Data(), scaled.Stride(),
+                            target.Data(), target.Stride());
+  }
+};
+
+namespace linalg_detail {
+
+inline void ThrowDeterminantOverflow() {
+  throw std::overflow_error("Determinant: a minor overflows the element type");
+}
+
+template <typename T>
+T NarrowMinor(__int128 value) {
+  if (value < static_cast<__int128>(std::numeric_limits<T>::min()) ||
+      value > static_cast<__int128>(std::numeric_limits<T>::max())) {
+    ThrowDeterminantOverflow();
+  }
+  return static_cast<T>(value);
+}
+
+// Fraction-free (Bareiss) elimination for integral T. Every entry it
+// produces is a minor of the matrix; each step (a * d - b * c) / previous
+// is computed in 128-bit arithmetic, where the division is exact, and
+// std::overflow_error is thrown when the result does not fit in T (or an
+// intermediate product in 128 bits, which only uint64_t can cause).
+template <typename T>
+T Determinant(MatrixView<const T> matrix, std::true_type /*is_integral*/) {
+  DynMatrix<T> work(matrix);
+  size_t n = work.Rows();
+  bool negative = false;
+  T previous = T(1);
+  for (size_t kkk = 0; kkk + 1 < n; ++kkk) {
+    if (work(kkk, kkk) == T()) {
+      size_t pivot = kkk + 1;
+      while (pivot < n && work(pivot, kkk) == T()) {
+        ++pivot;
+      }
+      if (pivot == n) {
+        return T();
+      }
+      std::swap_ranges(work.RowData(kkk), work.RowData(kkk) + n,
+                       work.RowData(pivot));
+      negative = !negative;
+    }
+    for (size_t iii = kkk + 1; iii < n; ++iii) {
+      for (size_t jjj = kkk + 1; jjj < n; ++jjj) {
+        __int128 kept;
+        __int128 removed;
+        if (__builtin_mul_overflow(static_cast<__int128>(work(iii, jjj)),
+                                   static_cast<__int128>(work(kkk, kkk)),
+                                   &kept) ||
+            __builtin_mul_overflow(static_cast<__int128>(work(iii, kkk)),
+                                   static_cast<__int128>(work(kkk, jjj)),
+                                   &removed) ||
+            __builtin_sub_overflow(kept, removed, &kept)) {
+          ThrowDeterminantOverflow();
+        }
+        work(iii, jjj) =
+            NarrowMinor<T>(kept / static_cast<__int128>(previous));
+      }
+    }
+    previous = work(kkk, kkk);
+  }
+  if (n == 0) {
+    return T(1);
+  }
+  __int128 det = static_cast<__int128>(work(n - 1, n - 1));
+  return NarrowMinor<T>(negative ? -det : det);
+}
+
+template <typename T>
+T Determinant(MatrixView<const T> matrix, std::false_type /*is_integral*/) {
+  return LuDecomposition<T>(DynMatrix<T>(matrix)).Determinant();
+}
+
+}  // namespace linalg_detail
@@ -0,0 +1,551 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include "dyn_matrix.hpp"
+#include "kernels.hpp"
+
+// On-disk layout: a MatrixFileHeader, then the tiles in row-major tile order
+// starting at data_offset (page aligned). Every tile is stored whole,
+// tile_rows x tile_columns in row-major order; edge tiles are zero-padded, so
+// the position of any element is computed without an index.
+struct MatrixFileHeader {
+  char magic[8];
+  uint64_t rows;
+  uint64_t columns;
+  uint32_t dtype;
+  uint32_t element_size;
+  uint64_t tile_rows;
+  uint64_t tile_columns;
+  uint64_t data_offset;
+};
+
+enum class MatrixDType : uint32_t {
+  kInt8 = 1,
+  kInt16 = 2,
+  kInt32 = 3,
+  kInt64 = 4,
+  kFloat = 5,
+  kDouble = 6,
+};
+
+template <typename T>
+struct MatrixFileType;
+
+template <>
+struct MatrixFileType<int8_t> {
+  static const MatrixDType kDType = MatrixDType::kInt8;
+};
+template <>
+struct MatrixFileType<int16_t> {
+  static const MatrixDType kDType = MatrixDType::kInt16;
+};
+template <>
+struct MatrixFileType<int32_t> {
+  static const MatrixDType kDType = MatrixDType::kInt32;
+};
+template <>
+struct MatrixFileType<int64_t> {
+  static const MatrixDType kDType = MatrixDType::kInt64;
+};
+template <>
+struct MatrixFileType<float> {
+  static const MatrixDType kDType = MatrixDType::kFloat;
+};
+template <>
+struct MatrixFileType<double> {
+  static const MatrixDType kDType = MatrixDType::kDouble;
+};
+
+namespace mapped_detail {
+
+const char kMagic[8] = {'M', 'A', 'T', 'R', 'I', 'X', '0', '1'};
+const uint64_t kPageSize = 4096;
+
+inline void ThrowErrno(const std::string& what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+inline void ReadAll(int fd, void* buffer, size_t size, uint64_t offset) {
+  char* out = static_cast<char*>(buffer);
+  while (size > 0) {
+    ssize_t done = ::pread(fd, out, size, static_cast<off_t>(offset));
+    if (done < 0 && errno == EINTR) {
+      continue;
+    }
+    if (done == 0) {
+      throw std::runtime_error("matrix file: unexpected end of file");
+    }
+    if (done < 0) {
+      ThrowErrno("matrix file: read failed");
+    }
+    out += done;
+    offset += done;
+    size -= done;
+  }
+}
+
+inline void WriteAll(int fd, const void* buffer, size_t size,
+                     uint64_t offset) {
+  const char* in = static_cast<const char*>(buffer);
+  while (size > 0) {
+    ssize_t done = ::pwrite(fd, in, size, static_cast<off_t>(offset));
+    if (done < 0 && errno == EINTR) {
+      continue;
+    }
+    if (done <= 0) {
+      ThrowErrno("matrix file: write failed");
+    }
+    in += done;
+    offset += done;
+    size -= done;
+  }
+}
+
+inline uint64_t CeilDiv(uint64_t value, uint64_t divisor) {
+  return (value + divisor - 1) / divisor;
+}
+
+// False when the tiles a header describes would not fit in 64-bit file
+// offsets, e.g. for a corrupt header.
+inline bool SizeFits(const MatrixFileHeader& header) {
+  uint64_t grid_rows = header.rows / header.tile_rows + 1;
+  uint64_t grid_columns = header.columns / header.tile_columns + 1;
+  uint64_t size;
+  return !__builtin_mul_overflow(grid_rows, grid_columns, &size) &&
+         !__builtin_mul_overflow(size, header.tile_rows, &size) &&
+         !__builtin_mul_overflow(size, header.tile_columns, &size) &&
+         !__builtin_mul_overflow(size, uint64_t(header.element_size),
+                                 &size) &&
+         !__builtin_add_overflow(size, header.data_offset, &size) &&
+         size <= uint64_t(std::numeric_limits<off_t>::max());
+}
+
+}  // namespace mapped_detail
+
+// An open matrix file: the header plus whole-tile pread/pwrite.
+template <typename T>
+class MatrixFile {
+ private:
+  int fd_ = -1;
+  MatrixFileHeader header_{};
+
+  MatrixFile(int fd, const MatrixFileHeader& header)
+      : fd_(fd), header_(header) {}
+
+ public:
+  static MatrixFile Create(const std::string& path, size_t rows,
+                           size_t columns, size_t tile_rows = 256,
+                           size_t tile_columns = 256) {
+    if (tile_rows == 0 || tile_columns == 0) {
+      throw std::invalid_argument("MatrixFile: empty tile");
+    }
+    MatrixFileHeader header{};
+    std::memcpy(header.magic, mapped_detail::kMagic, sizeof(header.magic));
+    header.rows = rows;
+    header.columns = columns;
+    header.dtype = static_cast<uint32_t>(MatrixFileType<T>::kDType);
+    header.element_size = sizeof(T);
+    header.tile_rows = tile_rows;
+    header.tile_columns = tile_columns;
+    header.data_offset = mapped_detail::kPageSize;
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      mapped_detail::ThrowErrno("MatrixFile: cannot create " + path);
+    }
+    MatrixFile file(fd, header);
+    // ftruncate zero-fills, which provides the tile padding for free.
+    if (::ftruncate(fd, static_cast<off_t>(file.FileSize())) != 0) {
+      mapped_detail::ThrowErrno("MatrixFile: cannot resize " + path);
+    }
+    mapped_detail::WriteAll(fd, &header, sizeof(header), 0);
+    return file;
+  }
+
+  static MatrixFile Open(const std::string& path, bool writable = false) {
+    int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+      mapped_detail::ThrowErrno("MatrixFile: cannot open " + path);
+    }
+    MatrixFileHeader header{};
+    MatrixFile file(fd, header);
+    mapped_detail::ReadAll(fd, &file.header_, sizeof(header), 0);
+    const MatrixFileHeader& stored = file.header_;
+    if (std::memcmp(stored.magic, mapped_detail::kMagic,
+                    sizeof(stored.magic)) != 0 ||
+        stored.dtype != static_cast<uint32_t>(MatrixFileType<T>::kDType) ||
+        stored.element_size != sizeof(T) || stored.tile_rows == 0 ||
+        stored.tile_columns == 0 || stored.data_offset < sizeof(header) ||
+        !mapped_detail::SizeFits(stored)) {
+      throw std::runtime_error("MatrixFile: bad header in " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      mapped_detail::ThrowErrno("MatrixFile: cannot stat " + path);
+    }
+    if (static_cast<uint64_t>(info.st_size) < file.FileSize()) {
+      throw std::runtime_error("MatrixFile: truncated file " + path);
+    }
+    return file;
+  }
+
+  MatrixFile(MatrixFile&& other) noexcept
+      : fd_(std::exchange(other.fd_, -1)), header_(other.header_) {}
+
+  MatrixFile& operator=(MatrixFile&& other) noexcept {
+    if (this != &other) {
+      Close();
+      fd_ = std::exchange(other.fd_, -1);
+      header_ = other.header_;
+    }
+    return *this;
+  }
+
+  MatrixFile(const MatrixFile& other) = delete;
+  MatrixFile& operator=(const MatrixFile& other) = delete;
+
+  ~MatrixFile() { Close(); }
+
+  int Fd() const { return fd_; }
+  const MatrixFileHeader& Header() const { return header_; }
+  size_t Rows() const { return header_.rows; }
+  size_t Columns() const { return header_.columns; }
+  size_t TileRows() const { return header_.tile_rows; }
+  size_t TileColumns() const { return header_.tile_columns; }
+  size_t TileElements() const { return TileRows() * TileColumns(); }
+  size_t TileGridRows() const {
+    return mapped_detail::CeilDiv(Rows(), TileRows());
+  }
+  size_t TileGridColumns() const {
+    return mapped_detail::CeilDiv(Columns(), TileColumns());
+  }
+
+  uint64_t FileSize() const {
+    return header_.data_offset +
+           TileGridRows() * TileGridColumns() * TileElements() * sizeof(T);
+  }
+
+  // Byte offset of element (row, column).
+  uint64_t Offset(size_t row, size_t column) const {
+    uint64_t tile = (row / TileRows()) * TileGridColumns() +
+                    column / TileColumns();
+    uint64_t inside =
+        (row % TileRows()) * TileColumns() + column % TileColumns();
+    return header_.data_offset + (tile * TileElements() + inside) * sizeof(T);
+  }
+
+  void ReadTile(size_t tile_row, size_t tile_column, T* buffer) const {
+    mapped_detail::ReadAll(fd_, buffer, TileElements() * sizeof(T),
+                           Offset(tile_row * TileRows(),
+                                  tile_column * TileColumns()));
+  }
+
+  void WriteTile(size_t tile_row, size_t tile_column, const T* buffer) {
+    mapped_detail::WriteAll(fd_, buffer, TileElements() * sizeof(T),
+                            Offset(tile_row * TileRows(),
+                                   tile_column * TileColumns()));
+  }
+
+ private:
+  void Close() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+};
+
+// A matrix file mapped into memory, with the same (i, j) element access as
+// Matrix. Pages are loaded on first touch, so matrices larger than RAM can be
+// read and written piecewise.
+template <typename T>
+class MappedMatrix {
+ private:
+  MatrixFile<T> file_;
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  char* data_ = nullptr;
+
+ public:
+  MappedMatrix(MatrixFile<T> file, bool writable) : file_(std::move(file)) {
+    mapping_size_ = file_.FileSize();
+    mapping_ = ::mmap(nullptr, mapping_size_,
+                      writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, file_.Fd(), 0);
+    if (mapping_ == MAP_FAILED) {
+      mapping_ = nullptr;
+      mapped_detail::ThrowErrno("MappedMatrix: mmap failed");
+    }
+    data_ = static_cast<char*>(mapping_);
+  }
+
+  static MappedMatrix Open(const std::string& path, bool writable = false) {
+    return MappedMatrix(MatrixFile<T>::Open(path, writable), writable);
+  }
+
+  static MappedMatrix Create(const std::string& path, size_t rows,
+                             size_t columns, size_t tile_rows = 256,
+                             size_t tile_columns = 256) {
+    return MappedMatrix(MatrixFile<T>::Create(path, rows, columns, tile_rows,
+                                              tile_columns),
+                        true);
+  }
+
+  MappedMatrix(MappedMatrix&& other) noexcept
+      : file_(std::move(other.file_)),
+        mapping_(std::exchange(other.mapping_, nullptr)),
+        mapping_size_(std::exchange(other.mapping_size_, 0)),
+        data_(std::exchange(other.data_, nullptr)) {}
+
+  MappedMatrix& operator=(MappedMatrix&& other) noexcept {
+    if (this != &other) {
+      Unmap();
+      file_ = std::move(other.file_);
+      mapping_ = std::exchange(other.mapping_, nullptr);
+      mapping_size_ = std::exchange(other.mapping_size_, 0);
+      data_ = std::exchange(other.data_, nullptr);
+    }
+    return *this;
+  }
+
+  MappedMatrix(const MappedMatrix& other) = delete;
+  MappedMatrix& operator=(const MappedMatrix& other) = delete;
+
+  ~MappedMatrix() { Unmap(); }
+
+  const MatrixFile<T>& File() const { return file_; }
+  size_t Rows() const { return file_.Rows(); }
+  size_t Columns() const { return file_.Columns(); }
+
+  T& operator()(size_t rows, size_t columns) {
+    return *reinterpret_cast<T*>(data_ + file_.Offset(rows, columns));
+  }
+
+  T operator()(size_t rows, size_t columns) const {
+    return *reinterpret_cast<const T*>(data_ + file_.Offset(rows, columns));
+  }
+
+  // Zero-copy view of one tile, trimmed to the matrix edge.
+  MatrixView<T> Tile(size_t tile_row, size_t tile_column) {
+    size_t row = tile_row * file_.TileRows();
+    size_t column = tile_column * file_.TileColumns();
+    return {&operator()(row, column),
+            std::min(file_.TileRows(), Rows() - row),
+            std::min(file_.TileColumns(), Columns() - column),
+            file_.TileColumns()};
+  }
+
+  // Asks the kernel to start reading a tile ahead of use.
+  void Prefetch(size_t tile_row, size_t tile_column) const {
+    uint64_t begin = file_.Offset(tile_row * file_.TileRows(),
+                                  tile_column * file_.TileColumns());
+    uint64_t aligned = begin / mapped_detail::kPageSize *
+                       mapped_detail::kPageSize;
+    ::madvise(data_ + aligned,
+              begin - aligned + file_.TileElements() * sizeof(T),
+              MADV_WILLNEED);
+  }
+
+  void Flush() {
+    if (::msync(mapping_, mapping_size_, MS_SYNC) != 0) {
+      mapped_detail::ThrowErrno("MappedMatrix: msync failed");
+    }
+  }
+
+  DynMatrix<T> ToDense() const {
+    DynMatrix<T> dense(Rows(), Columns());
+    for (size_t iii = 0; iii < Rows(); ++iii) {
+      for (size_t jjj = 0; jjj < Columns(); ++jjj) {
+        dense(iii, jjj) = operator()(iii, jjj);
+      }
+    }
+    return dense;
+  }
+
+ private:
+  void Unmap() {
+    if (mapping_ != nullptr) {
+      ::munmap(mapping_, mapping_size_);
+      mapping_ = nullptr;
+    }
+  }
+};
+
+// Writes an in-memory matrix to `path` in the tiled format.
+template <typename T>
+void StoreMatrix(const std::string& path, MatrixView<const T> matrix,
+                 size_t tile_rows = 256, size_t tile_columns = 256) {
+  auto file = MatrixFile<T>::Create(path, matrix.Rows(), matrix.Columns(),
+                                    tile_rows, tile_columns);
+  AlignedVector<T> tile(file.TileElements());
+  for (size_t ti = 0; ti < file.TileGridRows(); ++ti) {
+    for (size_t tj = 0; tj < file.TileGridColumns(); ++tj) {
+      std::fill(tile.begin(), tile.end(), T());
+      size_t row = ti * tile_rows;
+      size_t column = tj * tile_columns;
+      size_t rows = std::min(tile_rows, matrix.Rows() - row);
+      size_t columns = std::min(tile_columns, matrix.Columns() - column);
+      for (size_t iii = 0; iii < rows; ++iii) {
+        const T* src = &matrix(row + iii, column);
+        std::copy(src, src + columns, tile.data() + iii * tile_columns);
+      }
+      file.WriteTile(ti, tj, tile.data());
+    }
+  }
+}
+
+namespace mapped_detail {
+
+// Runs load(step, step & 1) for steps 0..steps-1 on one background thread,
+// at most one step ahead of the consumer, so the caller can work on one
+// buffer slot while the other is filled. A load that throws stops the
+// thread and the error is rethrown from the matching Acquire.
+class TilePrefetcher {
+ public:
+  template <typename Load>
+  TilePrefetcher(size_t steps, Load load)
+      : worker_([this, steps, load] { Run(steps, load); }) {}
+
+  TilePrefetcher(const TilePrefetcher&) = delete;
+  TilePrefetcher& operator=(const TilePrefetcher&) = delete;
+
+  ~TilePrefetcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    changed_.notify_all();
+    worker_.join();
+  }
+
+  // Blocks until slot step & 1 holds step's tiles.
+  void Acquire(size_t step) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return loaded_ > step || error_; });
+    if (loaded_ <= step) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+  // Hands slot step & 1 back for step + 2.
+  void Release(size_t step) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      released_ = step + 1;
+    }
+    changed_.notify_all();
+  }
+
+ private:
+  template <typename Load>
+  void Run(size_t steps, const Load& load) {
+    for (size_t step = 0; step < steps; ++step) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return step < released_ + 2 || stop_; });
+        if (stop_) {
+          return;
+        }
+      }
+      try {
+        load(step, step & 1);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+        changed_.notify_all();
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loaded_ = step + 1;
+      }
+      changed_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  size_t loaded_ = 0;
+  size_t released_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+  // Last, so the state above exists before the thread starts.
+  std::thread worker_;
+};
+
+}  // namespace mapped_detail
+
+// C = A * B for matrix files that need not fit in memory. A's tile width
+// must equal B's tile height; C gets A's tile height and B's tile width.
+// Tiles are read with pread into two buffer pairs: while one pair is being
+// multiplied, one loader thread fills the other, so disk reads and the GEMM
+// kernel overlap. Memory use is five tiles regardless of matrix size.
+template <typename T>
+void OutOfCoreMultiply(const std::string& a_path, const std::string& b_path,
+                       const std::string& c_path) {
+  auto a = MatrixFile<T>::Open(a_path);
+  auto b = MatrixFile<T>::Open(b_path);
+  if (a.Columns() != b.Rows() || a.TileColumns() != b.TileRows()) {
+    throw std::invalid_argument("OutOfCoreMultiply: shape or tile mismatch");
+  }
+  auto c = MatrixFile<T>::Create(c_path, a.Rows(), b.Columns(), a.TileRows(),
+                                 b.TileColumns());
+  size_t grid_rows = c.TileGridRows();
+  size_t grid_columns = c.TileGridColumns();
+  size_t inner = a.TileGridColumns();
+  size_t steps = grid_rows * grid_columns * inner;
+  if (steps == 0) {
+    return;
+  }
+
+  AlignedVector<T> a_tiles[2] = {AlignedVector<T>(a.TileElements()),
+                                 AlignedVector<T>(a.TileElements())};
+  AlignedVector<T> b_tiles[2] = {AlignedVector<T>(b.TileElements()),
+                                 AlignedVector<T>(b.TileElements())};
+  AlignedVector<T> acc(c.TileElements());
+  // Step s multiplies A(ti, p) * B(p, tj) for C(ti, tj), p fastest.
+  auto load = [&](size_t step, size_t slot) {
+    size_t ti = step / (grid_columns * inner);
+    size_t tj = step / inner % grid_columns;
+    size_t ppp = step % inner;
+    a.ReadTile(ti, ppp, a_tiles[slot].data());
+    b.ReadTile(ppp, tj, b_tiles[slot].data());
+  };
+
+  mapped_detail::TilePrefetcher prefetcher(steps, load);
+  for (size_t step = 0; step < steps; ++step) {
+    size_t slot = step & 1;
+    prefetcher.Acquire(step);
+    size_t ppp = step % inner;
+    if (ppp == 0) {
+      std::fill(acc.begin(), acc.end(), T());
+    }
+    // Padding is zero, so whole tiles can be multiplied.
+    matrix_kernels::Gemm(a.TileRows(), a.TileColumns(), b.TileColumns(),
+                         a_tiles[slot].data(), a.TileColumns(),
+                         b_tiles[slot].data(), b.TileColumns(), acc.data(),
+                         c.TileColumns());
+    if (ppp + 1 == inner) {
+      size_t ti = step / (grid_columns * inner);
+      size_t tj = step / inner % grid_columns;
+      c.WriteTile(ti, tj, acc.data());
+    }
+    prefetcher.Release(step);
+  }
+}
@@ -1,192 +1,273 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
+#include "dyn_matrix.hpp"
+#include "kernels.hpp"
+#include "linalg.hpp"
+
 template <size_t N, size_t M, typename T = int64_t>
 class Matrix {
  private:
-  std::vector<std::vector<T>> Data_;
+  AlignedVector<T> Data_;
   size_t rows_;
   size_t columns_;
 
  public:
-  Matrix()
-      : Data_(std::vector<std::vector<T>>(N, std::vector<T>(M))),
-        rows_(N),
-        columns_(M) {}
-
-  Matrix(std::vector<std::vector<T>> mat)
-      : Data_(mat), rows_(mat.size()), columns_(mat[0].size()) {}
-
-  Matrix(T elem) : Matrix() {
-    for (size_t i = 0; i < Data_.size(); i++) {
-      for (size_t j = 0; j < Data_[0].size(); j++) {
-        operator()(i, j) = elem;
-      }
+  Matrix() : Data_(N * M), rows_(N), columns_(M) {}
+
+  Matrix(std::vector<std::vector<T>> mat) : Matrix() {
+    for (size_t i = 0; i < rows_; i++) {
+      std::copy(mat[i].begin(), mat[i].end(), Data_.begin() + i * columns_);
     }
   }
 
-  Matrix(const Matrix& other)
-      : rows_(other.rows_), columns_(other.columns_), Data_(other.Data_) {}
+  Matrix(T elem) : Data_(N * M, elem), rows_(N), columns_(M) {}
 
-  Matrix& operator=(const Matrix& other) {
-    if (Data_ != other.Data_) {
-      rows_ = other.rows_;
-      columns_ = other.columns_;
-      Data_ = other.Data_;
+  // Takes over the storage of a runtime-sized matrix of the same shape.
+  explicit Matrix(DynMatrix<T>&& other) : rows_(N), columns_(M) {
+    if (other.Rows() != N || other.Columns() != M) {
+      throw std::invalid_argument("Matrix: DynMatrix shape mismatch");
     }
-    return *this;
+    Data_ = std::move(other).Release();
   }
 
+  Matrix(const Matrix& other) = default;
+  Matrix& operator=(const Matrix& other) = default;
+
+  // Moves hand the buffer over. As with the standard containers, a
+  // moved-from Matrix may only be assigned to or destroyed.
+  Matrix(Matrix&& other) noexcept = default;
+  Matrix& operator=(Matrix&& other) noexcept = default;
+
+  // Hands the storage over to a DynMatrix without copying; *this is left
+  // moved-from.
+  DynMatrix<T> ToDyn() && { return DynMatrix<T>(N, M, std::move(Data_)); }
+
   Matrix& operator+=(const Matrix& other) {
-    for (size_t i = 0; i < rows_; i++) {
-      for (size_t j = 0; j < columns_; j++) {
-        operator()(i, j) += other.operator()(i, j);
-      }
-    }
+    matrix_kernels::Add(rows_, columns_, other.Data(), M, Data(), M);
     return *this;
   }
 
-  Matrix operator+(const Matrix& other) {
+  Matrix operator+(const Matrix& other) const {
     auto tmp = *this;
     tmp += other;
     return tmp;
   }
 
   Matrix& operator-=(const Matrix& other) {
-    for (size_t i = 0; i < rows_; i++) {
-      for (size_t j = 0; j < columns_; j++) {
-        operator()(i, j) -= other.operator()(i, j);
-      }
-    }
+    matrix_kernels::Sub(rows_, columns_, other.Data(), M, Data(), M);
     return *this;
   }
 
-  Matrix operator-(const Matrix& other) {
+  Matrix operator-(const Matrix& other) const {
     auto tmp = *this;
     tmp -= other;
     return tmp;
   }
   Matrix& operator*=(T elem) {
-    for (size_t iii = 0; iii < rows_; iii++) {
-      for (size_t jjj = 0; jjj < columns_; jjj++) {
-        operator()(iii, jjj) *= elem;
-      }
-    }
+    matrix_kernels::Scale(rows_, columns_, elem, Data(), M);
     return *this;
   }
 
-  Matrix operator==(const Matrix& other) { return (Data_ == other.Data_); }
+  bool operator==(const Matrix& other) const { return (Data_ == other.Data_); }
 
-  Matrix<M, N, T> Transposed() {
+  Matrix<M, N, T> Transposed() const {
     Matrix<M, N, T> copy;
-    for (size_t iii = 0; iii < columns_; ++iii) {
-      for (size_t jjj = 0; jjj < rows_; ++jjj) {
-        copy(iii, jjj) = operator()(jjj, iii);
-      }
-    }
+    matrix_kernels::Transpose(rows_, columns_, Data(), M, copy.Data(), N);
     return copy;
   }
 
-  T& operator()(size_t rows, size_t columns) { return Data_[rows][columns]; }
+  T* Data() { return Data_.data(); }
+  const T* Data() const { return Data_.data(); }
+
+  MatrixView<T> View() { return {Data_.data(), N, M, M}; }
+  MatrixView<const T> View() const { return {Data_.data(), N, M, M}; }
+
+  T& operator()(size_t rows, size_t columns) {
+    return Data_[rows * M + columns];
+  }
 
   T operator()(size_t rows, size_t columns) const {
-    return Data_[rows][columns];
+    return Data_[rows * M + columns];
   }
 };
 
 template <size_t N, typename T>
 class Matrix<N, N, T> {
  private:
-  std::vector<std::vector<T>> Data_;
+  AlignedVector<T> Data_;
   size_t rows_;
 
  public:
-  Matrix()
-      : Data_(std::vector<std::vector<T>>(N, std::vector<T>(N))), rows_(N) {}
+  Matrix() : Data_(N * N), rows_(N) {}
 
-  Matrix(std::vector<std::vector<T>> mat) : Data_(mat), rows_(mat.size()) {}
-
-  Matrix(T elem) : rows_(N) {
-    Data_ = std::vector<std::vector<T>>(N);
-    for (size_t i = 0; i < Data_.size(); i++) {
-      for (size_t j = 0; j < Data_[0].size(); j++) {
-        operator()(i, j) = elem;
-      }
+  Matrix(std::vector<std::vector<T>> mat) : Matrix() {
+    for (size_t i = 0; i < rows_; i++) {
+      std::copy(mat[i].begin(), mat[i].end(), Data_.begin() + i * rows_);
     }
   }
 
-  Matrix(const Matrix& other) : rows_(other.rows_), Data_(other.Data_) {}
+  Matrix(T elem) : Data_(N * N, elem), rows_(N) {}
 
-  Matrix& operator=(const Matrix& other) {
-    rows_ = other.rows_;
-    Data_ = other.Data_;
-    return *this;
+  explicit Matrix(DynMatrix<T>&& other) : rows_(N) {
+    if (other.Rows() != N || other.Columns() != N) {
+      throw std::invalid_argument("Matrix: DynMatrix shape mismatch");
+    }
+    Data_ = std::move(other).Release();
   }
 
+  Matrix(const Matrix& other) = default;
+  Matrix& operator=(const Matrix& other) = default;
+
+  Matrix(Matrix&& other) noexcept = default;
+  Matrix& operator=(Matrix&& other) noexcept = default;
+
+  DynMatrix<T> ToDyn() && { return DynMatrix<T>(N, N, std::move(Data_)); }
+
   Matrix& operator+=(const Matrix& other) {
-    for (size_t i = 0; i < rows_; i++) {
-      for (size_t j = 0; j < rows_; j++) {
-        operator()(i, j) += other.operator()(i, j);
-      }
-    }
+    matrix_kernels::Add(rows_, rows_, other.Data(), N, Data(), N);
     return *this;
   }
 
-  Matrix operator+(const Matrix& other) {
+  Matrix operator+(const Matrix& other) const {
     auto tmp = *this;
     tmp += other;
     return tmp;
   }
 
   Matrix& operator-=(const Matrix& other) {
-    for (size_t iii = 0; iii < rows_; iii++) {
-      for (size_t jjj = 0; jjj < rows_; jjj++) {
-        operator()(iii, jjj) -= other.operator()(iii, jjj);
-      }
-    }
+    matrix_kernels::Sub(rows_, rows_, other.Data(), N, Data(), N);
     return *this;
   }
 
-  Matrix operator-(const Matrix& other) {
+  Matrix operator-(const Matrix& other) const {
     auto tmp = *this;
     tmp -= other;
     return tmp;
   }
   Matrix& operator*=(T elem) {
-    for (size_t iii = 0; iii < rows_; iii++) {
-      for (size_t jjj = 0; jjj < rows_; jjj++) {
-        operator()(iii, jjj) *= elem;
-      }
-    }
+    matrix_kernels::Scale(rows_, rows_, elem, Data(), N);
     return *this;
   }
 
-  bool operator==(const Matrix& other) { return (Data_ == other.Data_); }
+  bool operator==(const Matrix& other) const { return (Data_ == other.Data_); }
 
-  Matrix<N, N, T> Transposed() {
+  Matrix<N, N, T> Transposed() const {
     Matrix<N, N, T> copy;
-    for (size_t iii = 0; iii < rows_; ++iii) {
-      for (size_t jjj = 0; jjj < rows_; ++jjj) {
-        copy(iii, jjj) = operator()(jjj, iii);
-      }
-    }
+    matrix_kernels::Transpose(rows_, rows_, Data(), N, copy.Data(), N);
     return copy;
   }
 
-  T Trace() {
-    T res;
+  T Trace() const {
+    T res = T();
     for (size_t iii = 0; iii < rows_; ++iii) {
       res += operator()(iii, iii);
     }
     return res;
   }
 
-  T& operator()(size_t rows, size_t columns) { return Data_[rows][columns]; }
+  // (*this)^power by square-and-multiply. Products are written into one
+  // preallocated scratch matrix and swapped with the result or the base, so
+  // the loop never allocates.
+  Matrix Pow(uint64_t power) const { return Pow(power, NoReduction()); }
+
+  // Same, with every product reduced by `policy`, e.g.
+  // m.Pow(k, ModularReduction<int64_t>{1000000007}). Throws
+  // std::invalid_argument for a modulus <= 0.
+  template <typename Reduction>
+  Matrix Pow(uint64_t power, const Reduction& policy) const {
+    matrix_kernels::Validate(policy);
+    Matrix result;
+    Matrix base = *this;
+    Matrix scratch;
+    matrix_kernels::Reduce(policy, N * N, base.Data());
+    bool is_identity = true;
+    while (power > 0) {
+      if (power & 1) {
+        if (is_identity) {
+          result.Data_ = base.Data_;
+          is_identity = false;
+        } else {
+          matrix_kernels::MultiplyInto(policy, N, result.Data(), base.Data(),
+                                       scratch.Data());
+          std::swap(result.Data_, scratch.Data_);
+        }
+      }
+      power >>= 1;
+      if (power > 0) {
+        matrix_kernels::MultiplyInto(policy, N, base.Data(), base.Data(),
+                                     scratch.Data());
+        std::swap(base.Data_, scratch.Data_);
+      }
+    }
+    if (is_identity) {
+      for (size_t iii = 0; iii < N; ++iii) {
+        result(iii, iii) = T(1);
+      }
+      matrix_kernels::Reduce(policy, N * N, result.Data());
+    }
+    return result;
+  }
+
+  // Exact (fraction-free) for integral T, throwing std::overflow_error when
+  // a minor does not fit in T; via LU otherwise.
+  T Determinant() const {
+    return linalg_detail::Determinant(View(), std::is_integral<T>());
+  }
+
+  // The factorizations below exist only for floating-point T; integer
+  // elimination would truncate every division. Keep the returned object to
+  // solve against many right-hand sides without refactoring.
+  LuDecomposition<T> Lu() const
+    requires std::is_floating_point_v<T>
+  {
+    return LuDecomposition<T>(DynMatrix<T>(View()));
+  }
+
+  CholeskyDecomposition<T> Cholesky() const
+    requires std::is_floating_point_v<T>
+  {
+    return CholeskyDecomposition<T>(DynMatrix<T>(View()));
+  }
+
+  QrDecomposition<T> Qr() const
+    requires std::is_floating_point_v<T>
+  {
+    return QrDecomposition<T>(DynMatrix<T>(View()));
+  }
+
+  Matrix Inverse() const
+    requires std::is_floating_point_v<T>
+  {
+    return Matrix(Lu().Inverse());
+  }
+
+  // X with (*this) * X == rhs.
+  template <size_t K>
+    requires std::is_floating_point_v<T>
+  Matrix<N, K, T> Solve(const Matrix<N, K, T>& rhs) const {
+    return Matrix<N, K, T>(Lu().Solve(DynMatrix<T>(rhs.View())));
+  }
+
+  T* Data() { return Data_.data(); }
+  const T* Data() const { return Data_.data(); }
+
+  MatrixView<T> View() { return {Data_.data(), N, N, N}; }
+  MatrixView<const T> View() const { return {Data_.data(), N, N, N}; }
+
+  T& operator()(size_t rows, size_t columns) {
+    return Data_[rows * N + columns];
+  }
 
   T operator()(size_t rows, size_t columns) const {
-    return Data_[rows][columns];
+    return Data_[rows * N + columns];
   }
 };
 
@@ -194,19 +275,114 @@ template <size_t N, size_t M, size_t K, typename T>
 Matrix<N, K, T> operator*(const Matrix<N, M, T>& first,
                           const Matrix<M, K, T>& second) {
   Matrix<N, K, T> copy;
-  for (size_t rows1 = 0; rows1 < N; ++rows1) {
-    for (size_t columns1 = 0; columns1 < K; ++columns1) {
-      for (size_t columns2 = 0; columns2 < M; ++columns2) {
-        copy(rows1, columns1) +=
-            first(rows1, columns2) * second(columns2, columns1);
-      }
-    }
+  matrix_kernels::Gemm(N, M, K, first.Data(), M, second.Data(), K, copy.Data(),
+                       K);
+  return copy;
+}
+
+// y = first * x for raw vectors of length M (x) and N (y).
+template <size_t N, size_t M, typename T>
+void Multiply(const Matrix<N, M, T>& first, const T* x, T* y) {
+  matrix_kernels::Gemv(N, M, first.Data(), M, x, y);
+}
+
+template <size_t N, size_t M, typename T>
+std::array<T, N> operator*(const Matrix<N, M, T>& first,
+                           const std::array<T, M>& x) {
+  std::array<T, N> y;
+  Multiply(first, x.data(), y.data());
+  return y;
+}
+
+template <size_t N, size_t M, typename T>
+std::vector<T> operator*(const Matrix<N, M, T>& first,
+                         const std::vector<T>& x) {
+  if (x.size() != M) {
+    throw std::invalid_argument("GEMV: shape mismatch");
+  }
+  std::vector<T> y(N);
+  Multiply(first, x.data(), y.data());
+  return y;
+}
+
+// out[l] = first[l] * second[l] for every l. Chunks of kBatchLanes operands
+// are gathered into structure-of-arrays buffers so SIMD lanes run across the
+// batch, multiplied, and scattered back.
+template <size_t N, size_t M, size_t K, typename T>
+void MultiplyBatch(std::span<const Matrix<N, M, T>> first,
+                   std::span<const Matrix<M, K, T>> second,
+                   std::span<Matrix<N, K, T>> out) {
+  if (first.size() != second.size() || first.size() != out.size()) {
+    throw std::invalid_argument("MultiplyBatch: batch size mismatch");
   }
+  const size_t kLanes = matrix_kernels::kBatchLanes;
+  matrix_kernels::ParallelFor(
+      first.size(),
+      [&](size_t begin, size_t end) {
+        AlignedVector<T> a_soa(N * M * kLanes);
+        AlignedVector<T> b_soa(M * K * kLanes);
+        AlignedVector<T> c_soa(N * K * kLanes);
+        for (size_t base = begin; base < end; base += kLanes) {
+          size_t lanes = std::min(kLanes, end - base);
+          for (size_t lll = 0; lll < lanes; ++lll) {
+            const T* a = first[base + lll].Data();
+            const T* b = second[base + lll].Data();
+            for (size_t eee = 0; eee < N * M; ++eee) {
+              a_soa[eee * lanes + lll] = a[eee];
+            }
+            for (size_t eee = 0; eee < M * K; ++eee) {
+              b_soa[eee * lanes + lll] = b[eee];
+            }
+          }
+          std::fill(c_soa.begin(), c_soa.begin() + N * K * lanes, T());
+          matrix_kernels::GemmBatch(N, M, K, lanes, a_soa.data(), b_soa.data(),
+                                    c_soa.data());
+          for (size_t lll = 0; lll < lanes; ++lll) {
+            T* c = out[base + lll].Data();
+            for (size_t eee = 0; eee < N * K; ++eee) {
+              c[eee] = c_soa[eee * lanes + lll];
+            }
+          }
+        }
+      },
+      N * M * K);
+}
+
+template <size_t N, size_t M, size_t K, typename T>
+std::vector<Matrix<N, K, T>> MultiplyBatch(
+    const std::vector<Matrix<N, M, T>>& first,
+    const std::vector<Matrix<M, K, T>>& second) {
+  std::vector<Matrix<N, K, T>> out(first.size());
+  MultiplyBatch(std::span<const Matrix<N, M, T>>(first),
+                std::span<const Matrix<M, K, T>>(second),
+                std::span<Matrix<N, K, T>>(out));
+  return out;
+}
+
+// Product in a wider type: int8/int16 -> int32, int32 -> int64,
+// float -> double.
+template <size_t N, size_t M, size_t K, typename T>
+Matrix<N, K, typename matrix_kernels::Widened<T>::Type> MultiplyWide(
+    const Matrix<N, M, T>& first, const Matrix<M, K, T>& second) {
+  Matrix<N, K, typename matrix_kernels::Widened<T>::Type> copy;
+  matrix_kernels::GemmWiden(N, M, K, first.Data(), M, second.Data(), K,
+                            copy.Data(), K);
   return copy;
 }
+
+// int64 product that clamps to the int64 range instead of wrapping.
+template <size_t N, size_t M, size_t K>
+Matrix<N, K, int64_t> MultiplySaturating(const Matrix<N, M, int64_t>& first,
+                                         const Matrix<M, K, int64_t>& second) {
+  Matrix<N, K, int64_t> copy;
+  matrix_kernels::GemmSaturating(N, M, K, first.Data(), M, second.Data(), K,
+                                 copy.Data(), K);
+  return copy;
+}
+
 template <size_t N, size_t M, typename T>
 Matrix<N, M, T> operator*(const Matrix<N, M, T>& first, const T& elem) {
   Matrix<N, M, T> copy = first;
   copy *= elem;
   return copy;
-}
\ No newline at end of file
+}
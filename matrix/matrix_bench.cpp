@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.hpp"
+
+// Throughput of the dense kernels behind Matrix and DynMatrix, checked
+// against naive reference loops and compared with the machine's measured
+// single-core peak (FMA issue rate and memcpy bandwidth).
+//
+//   matrix_bench            full run
+//   matrix_bench --check    small sizes, exits non-zero on a mismatch
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile double sink;
+
+template <typename Fn>
+double BestSeconds(size_t repeats, Fn fn) {
+  double best = 1e30;
+  for (size_t iii = 0; iii < repeats; ++iii) {
+    auto start = Clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+// Seconds per call of fn, repeating it enough times per sample that
+// cache-resident sizes are not lost in timer resolution.
+template <typename Fn>
+double SecondsPerCall(size_t repeats, double work, Fn fn) {
+  const double kWorkPerSample = 1 << 26;
+  size_t inner = std::max<size_t>(1, kWorkPerSample / std::max(work, 1.0));
+  return BestSeconds(repeats, [&] {
+           for (size_t iii = 0; iii < inner; ++iii) {
+             fn();
+           }
+         }) /
+         inner;
+}
+
+// Independent multiply-add chains, enough of them to cover the FMA latency
+// on every port; the accumulators converge, so the values stay finite.
+const size_t kChains = 12;
+const size_t kPeakIterations = 1 << 22;
+
+template <typename T>
+double ScalarPeakFlops() {
+  T acc[kChains];
+  for (size_t ccc = 0; ccc < kChains; ++ccc) {
+    acc[ccc] = T(ccc);
+  }
+  const T mul = T(0.999999);
+  const T add = T(1e-6);
+  double seconds = BestSeconds(3, [&] {
+    for (size_t iii = 0; iii < kPeakIterations; ++iii) {
+      for (size_t ccc = 0; ccc < kChains; ++ccc) {
+        acc[ccc] = acc[ccc] * mul + add;
+      }
+    }
+  });
+  double total = 0;
+  for (size_t ccc = 0; ccc < kChains; ++ccc) {
+    total += acc[ccc];
+  }
+  sink = total;
+  return 2.0 * kChains * kPeakIterations / seconds;
+}
+
+#ifdef MATRIX_KERNELS_X86
+template <typename Lanes>
+__attribute__((target("avx2,fma"))) void FmaChains(
+    typename Lanes::Scalar* out) {
+  using Reg = typename Lanes::Reg;
+  Reg acc[kChains];
+  for (size_t ccc = 0; ccc < kChains; ++ccc) {
+    acc[ccc] = Lanes::Broadcast(typename Lanes::Scalar(ccc));
+  }
+  const Reg mul = Lanes::Broadcast(0.999999);
+  const Reg add = Lanes::Broadcast(1e-6);
+  for (size_t iii = 0; iii < kPeakIterations; ++iii) {
+    for (size_t ccc = 0; ccc < kChains; ++ccc) {
+      acc[ccc] = Lanes::Fma(acc[ccc], mul, add);
+    }
+  }
+  for (size_t ccc = 0; ccc < kChains; ++ccc) {
+    Lanes::Store(out + ccc * Lanes::kWidth, acc[ccc]);
+  }
+}
+
+template <typename Lanes>
+double VectorPeakFlops() {
+  std::vector<typename Lanes::Scalar> out(kChains * Lanes::kWidth);
+  double seconds = BestSeconds(3, [&] { FmaChains<Lanes>(out.data()); });
+  sink = out[0];
+  return 2.0 * kChains * Lanes::kWidth * kPeakIterations / seconds;
+}
+#endif
+
+// Peak multiply-add rate in FLOP/s for the path GemmUpdate<T> takes; zero
+// for integer types, which have no floating-point roof.
+template <typename T>
+double PeakFlops() {
+  if (!std::is_floating_point<T>::value) {
+    return 0;
+  }
+#ifdef MATRIX_KERNELS_X86
+  if (matrix_kernels::HasAvx2Fma()) {
+    if (std::is_same<T, float>::value) {
+      return VectorPeakFlops<matrix_kernels::simd::FloatLanes>();
+    }
+    if (std::is_same<T, double>::value) {
+      return VectorPeakFlops<matrix_kernels::simd::DoubleLanes>();
+    }
+  }
+#endif
+  return ScalarPeakFlops<T>();
+}
+
+// memcpy bandwidth in bytes/s for a working set of `bytes`, counting both
+// the read and the write. Measured per size, so a kernel whose operands fit
+// in cache is held to cache bandwidth rather than DRAM bandwidth.
+double MeasureBandwidth(size_t bytes) {
+  size_t half = std::max<size_t>(bytes / 2, 64);
+  std::vector<char> src(half, 1);
+  std::vector<char> dst(half, 0);
+  double seconds = SecondsPerCall(5, half, [&] {
+    std::memcpy(dst.data(), src.data(), half);
+    sink = dst[half / 2];
+  });
+  return 2.0 * half / seconds;
+}
+
+// Seconds to start and join one std::thread, the fixed cost that
+// matrix_kernels::kParallelGrain has to amortize.
+double ThreadStartSeconds() {
+  const size_t kThreads = 64;
+  return BestSeconds(5, [] {
+           for (size_t iii = 0; iii < kThreads; ++iii) {
+             std::thread worker([] { sink = 1; });
+             worker.join();
+           }
+         }) /
+         kThreads;
+}
+
+struct Machine {
+  double float_flops;
+  double double_flops;
+  double bandwidth;  // DRAM, for the summary line.
+
+  template <typename T>
+  double Flops() const {
+    if (std::is_same<T, float>::value) {
+      return float_flops;
+    }
+    if (std::is_same<T, double>::value) {
+      return double_flops;
+    }
+    return 0;
+  }
+};
+
+// Small integers keep every sum exact in float, double and the integer
+// types alike, so results compare with == against the reference.
+template <typename T>
+DynMatrix<T> RandomMatrix(size_t rows, size_t cols, std::mt19937_64& gen) {
+  std::uniform_int_distribution<int> value(-4, 4);
+  DynMatrix<T> result(rows, cols);
+  for (size_t iii = 0; iii < rows; ++iii) {
+    for (size_t jjj = 0; jjj < cols; ++jjj) {
+      result(iii, jjj) = T(value(gen));
+    }
+  }
+  return result;
+}
+
+template <typename T>
+DynMatrix<T> ReferenceMultiply(const DynMatrix<T>& a, const DynMatrix<T>& b) {
+  DynMatrix<T> c(a.Rows(), b.Columns());
+  for (size_t iii = 0; iii < a.Rows(); ++iii) {
+    for (size_t jjj = 0; jjj < b.Columns(); ++jjj) {
+      T sum = T();
+      for (size_t ppp = 0; ppp < a.Columns(); ++ppp) {
+        sum += a(iii, ppp) * b(ppp, jjj);
+      }
+      c(iii, jjj) = sum;
+    }
+  }
+  return c;
+}
+
+template <typename T>
+DynMatrix<T> ReferenceTranspose(const DynMatrix<T>& a) {
+  DynMatrix<T> t(a.Columns(), a.Rows());
+  for (size_t iii = 0; iii < a.Rows(); ++iii) {
+    for (size_t jjj = 0; jjj < a.Columns(); ++jjj) {
+      t(jjj, iii) = a(iii, jjj);
+    }
+  }
+  return t;
+}
+
+template <typename T>
+DynMatrix<T> ReferenceAdd(const DynMatrix<T>& a, const DynMatrix<T>& b) {
+  DynMatrix<T> c(a.Rows(), a.Columns());
+  for (size_t iii = 0; iii < a.Rows(); ++iii) {
+    for (size_t jjj = 0; jjj < a.Columns(); ++jjj) {
+      c(iii, jjj) = a(iii, jjj) + b(iii, jjj);
+    }
+  }
+  return c;
+}
+
+template <typename T>
+DynMatrix<T> ReferenceScale(const DynMatrix<T>& a, const T& elem) {
+  DynMatrix<T> c(a.Rows(), a.Columns());
+  for (size_t iii = 0; iii < a.Rows(); ++iii) {
+    for (size_t jjj = 0; jjj < a.Columns(); ++jjj) {
+      c(iii, jjj) = a(iii, jjj) * elem;
+    }
+  }
+  return c;
+}
+
+struct Measurement {
+  std::string kernel;
+  size_t size;
+  double seconds;
+  double flops;
+  double bytes;
+  bool ok;
+};
+
+// Achieved rate against min(peak FLOP/s, intensity * bandwidth); kernels
+// without arithmetic are measured against bandwidth alone.
+template <typename T>
+void Report(const std::string& type, const Measurement& run,
+            const Machine& machine, double bandwidth) {
+  double gflops = run.flops / run.seconds * 1e-9;
+  double gbytes = run.bytes / run.seconds * 1e-9;
+  std::cout << std::left << std::setw(8) << type << std::setw(10)
+            << run.kernel << "n=" << std::setw(6) << run.size << std::right
+            << std::fixed << std::setprecision(3) << std::setw(10)
+            << run.seconds * 1e3 << " ms" << std::setprecision(2)
+            << std::setw(9) << gflops << " GFLOP/s" << std::setw(9) << gbytes
+            << " GB/s";
+  double memory_roof = run.flops / run.bytes * bandwidth * 1e-9;
+  double peak = machine.Flops<T>() * 1e-9;
+  if (run.flops == 0) {
+    std::cout << "   roof " << std::setw(7) << bandwidth * 1e-9
+              << " GB/s     " << std::setw(5) << std::setprecision(0)
+              << 100.0 * gbytes / (bandwidth * 1e-9) << "%";
+  } else if (peak > 0 || run.flops <= run.bytes) {
+    double roof = peak > 0 ? std::min(peak, memory_roof) : memory_roof;
+    std::cout << "   roof " << std::setw(7) << roof << " GFLOP/s  "
+              << std::setw(5) << std::setprecision(0) << 100.0 * gflops / roof
+              << "%";
+  } else {
+    std::cout << "   roof       -";
+  }
+  std::cout << (run.ok ? "" : "  [MISMATCH]") << '\n';
+}
+
+template <typename T>
+bool RunType(const std::string& type, const std::vector<size_t>& sizes,
+             size_t repeats, const Machine& machine, std::mt19937_64& gen) {
+  namespace mk = matrix_kernels;
+  bool all_ok = true;
+  for (size_t size : sizes) {
+    DynMatrix<T> a = RandomMatrix<T>(size, size, gen);
+    DynMatrix<T> b = RandomMatrix<T>(size, size, gen);
+    double cells = static_cast<double>(size) * size;
+    double bandwidth = MeasureBandwidth(3 * cells * sizeof(T));
+    std::vector<Measurement> runs;
+
+    DynMatrix<T> c(size, size);
+    mk::Gemm(size, size, size, a.Data(), a.Stride(), b.Data(), b.Stride(),
+             c.Data(), c.Stride());
+    bool ok = c == ReferenceMultiply(a, b);
+    double seconds = SecondsPerCall(repeats, 2.0 * cells * size, [&] {
+      mk::Gemm(size, size, size, a.Data(), a.Stride(), b.Data(), b.Stride(),
+               c.Data(), c.Stride());
+    });
+    runs.push_back({"multiply", size, seconds, 2.0 * cells * size,
+                    4.0 * cells * sizeof(T), ok});
+
+    DynMatrix<T> t(size, size);
+    mk::Transpose(size, size, a.Data(), a.Stride(), t.Data(), t.Stride());
+    ok = t == ReferenceTranspose(a);
+    seconds = SecondsPerCall(repeats, 2.0 * cells * sizeof(T), [&] {
+      mk::Transpose(size, size, a.Data(), a.Stride(), t.Data(), t.Stride());
+    });
+    runs.push_back({"transpose", size, seconds, 0, 2.0 * cells * sizeof(T),
+                    ok});
+
+    DynMatrix<T> sum = a;
+    mk::Add(size, size, b.Data(), b.Stride(), sum.Data(), sum.Stride());
+    ok = sum == ReferenceAdd(a, b);
+    seconds = SecondsPerCall(repeats, 3.0 * cells * sizeof(T), [&] {
+      mk::Add(size, size, b.Data(), b.Stride(), sum.Data(), sum.Stride());
+    });
+    runs.push_back({"add", size, seconds, cells, 3.0 * cells * sizeof(T), ok});
+
+    DynMatrix<T> scaled = a;
+    mk::Scale(size, size, T(3), scaled.Data(), scaled.Stride());
+    ok = scaled == ReferenceScale(a, T(3));
+    // Scaling by -1 keeps the values bounded and cannot be optimized away.
+    seconds = SecondsPerCall(repeats, 2.0 * cells * sizeof(T), [&] {
+      mk::Scale(size, size, T(-1), scaled.Data(), scaled.Stride());
+    });
+    runs.push_back({"scale", size, seconds, cells, 2.0 * cells * sizeof(T),
+                    ok});
+
+    for (const auto& run : runs) {
+      Report<T>(type, run, machine, bandwidth);
+      all_ok = all_ok && run.ok;
+    }
+  }
+  return all_ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool check = argc > 1 && std::string(argv[1]) == "--check";
+  std::vector<size_t> sizes = check ? std::vector<size_t>{17, 64, 100}
+                                    : std::vector<size_t>{64, 256, 1024};
+  size_t repeats = check ? 1 : 5;
+  std::mt19937_64 gen(42);
+
+  Machine machine;
+  machine.float_flops = PeakFlops<float>();
+  machine.double_flops = PeakFlops<double>();
+  machine.bandwidth = MeasureBandwidth(check ? (16 << 20) : (512 << 20));
+  std::cout << std::fixed << std::setprecision(2)
+            << "peak (single core): float " << machine.float_flops * 1e-9
+            << " GFLOP/s, double " << machine.double_flops * 1e-9
+            << " GFLOP/s, DRAM memcpy " << machine.bandwidth * 1e-9
+            << " GB/s\n";
+  double thread_start = ThreadStartSeconds();
+  // A streamed multiply-add reads one 8-byte element.
+  std::cout << "thread start+join " << thread_start * 1e6 << " us, "
+            << std::setprecision(0) << thread_start * machine.bandwidth / 8
+            << " streamed multiply-adds; parallel grain "
+            << matrix_kernels::kParallelGrain << " per thread\n";
+
+  bool ok = RunType<float>("float", sizes, repeats, machine, gen);
+  ok = RunType<double>("double", sizes, repeats, machine, gen) && ok;
+  ok = RunType<int32_t>("int32", sizes, repeats, machine, gen) && ok;
+  ok = RunType<int64_t>("int64", sizes, repeats, machine, gen) && ok;
+  if (!ok) {
+    std::cout << "FAILED: kernel results differ from the reference\n";
+  }
+  return ok ? 0 : 1;
+}
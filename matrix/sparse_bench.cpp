@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sparse_matrix.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Entries within `half_width` of the diagonal, e.g. a 1-D stencil.
+CsrMatrix<double> Banded(size_t size, size_t half_width) {
+  std::vector<Triplet<double>> triplets;
+  for (size_t iii = 0; iii < size; ++iii) {
+    size_t begin = iii > half_width ? iii - half_width : 0;
+    size_t end = std::min(size, iii + half_width + 1);
+    for (size_t jjj = begin; jjj < end; ++jjj) {
+      triplets.push_back({iii, jjj, 1.0 / (1.0 + (iii > jjj ? iii - jjj
+                                                             : jjj - iii))});
+    }
+  }
+  return CsrMatrix<double>::FromTriplets(size, size, std::move(triplets));
+}
+
+// Uniformly scattered entries, `per_row` on average in every row.
+CsrMatrix<double> Random(size_t size, size_t per_row, std::mt19937_64& gen) {
+  std::uniform_int_distribution<size_t> column(0, size - 1);
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+  std::vector<Triplet<double>> triplets;
+  triplets.reserve(size * per_row);
+  for (size_t iii = 0; iii < size * per_row; ++iii) {
+    triplets.push_back({iii / per_row, column(gen), value(gen)});
+  }
+  return CsrMatrix<double>::FromTriplets(size, size, std::move(triplets));
+}
+
+// Row lengths follow a Zipf-like power law (a few very heavy rows, a long
+// tail of short ones), the shape of web and social graphs.
+CsrMatrix<double> PowerLaw(size_t size, size_t per_row, std::mt19937_64& gen) {
+  const double kExponent = 2.1;
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::uniform_int_distribution<size_t> column(0, size - 1);
+  std::vector<size_t> lengths(size);
+  double total = 0;
+  for (size_t iii = 0; iii < size; ++iii) {
+    double length = std::pow(1.0 - uniform(gen), -1.0 / (kExponent - 1.0));
+    lengths[iii] = std::min<size_t>(size, static_cast<size_t>(length));
+    total += lengths[iii];
+  }
+  double scale = static_cast<double>(size * per_row) / total;
+  std::vector<Triplet<double>> triplets;
+  for (size_t iii = 0; iii < size; ++iii) {
+    size_t length = std::min<size_t>(
+        size, std::max<size_t>(1, static_cast<size_t>(lengths[iii] * scale)));
+    for (size_t ppp = 0; ppp < length; ++ppp) {
+      triplets.push_back({iii, column(gen), uniform(gen)});
+    }
+  }
+  return CsrMatrix<double>::FromTriplets(size, size, std::move(triplets));
+}
+
+template <typename Fn>
+double BestSeconds(size_t repeats, Fn fn) {
+  double best = 1e30;
+  for (size_t iii = 0; iii < repeats; ++iii) {
+    auto start = Clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+bool CheckSpmv(const CsrMatrix<double>& matrix, const std::vector<double>& x,
+               const std::vector<double>& y) {
+  for (size_t iii = 0; iii < matrix.Rows(); ++iii) {
+    double sum = 0;
+    for (size_t ppp = matrix.RowPtr()[iii]; ppp < matrix.RowPtr()[iii + 1];
+         ++ppp) {
+      sum += matrix.Values()[ppp] * x[matrix.ColIdx()[ppp]];
+    }
+    if (std::abs(sum - y[iii]) > 1e-9 * (1.0 + std::abs(sum))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Run(const std::string& name, const CsrMatrix<double>& matrix,
+         size_t spmm_width, bool run_spgemm) {
+  const size_t kRepeats = 5;
+  size_t nnz = matrix.NonZeros();
+  std::vector<double> x(matrix.Columns(), 1.0);
+  std::vector<double> y(matrix.Rows());
+  for (size_t iii = 0; iii < x.size(); ++iii) {
+    x[iii] = 1.0 / (1.0 + iii % 7);
+  }
+
+  double spmv = BestSeconds(kRepeats,
+                            [&] { Multiply(matrix, x.data(), y.data()); });
+  bool ok = CheckSpmv(matrix, x, y);
+  // values + column indices + row pointers + gathered x + y.
+  double spmv_bytes = nnz * (sizeof(double) + sizeof(size_t) + sizeof(double)) +
+                      matrix.Rows() * (sizeof(size_t) + sizeof(double));
+  std::cout << name << "  n=" << matrix.Rows() << " nnz=" << nnz << '\n';
+  std::cout << "  SpMV    " << spmv * 1e3 << " ms, " << 2.0 * nnz / spmv * 1e-9
+            << " GFLOP/s, " << spmv_bytes / spmv * 1e-9 << " GB/s"
+            << (ok ? "" : "  [MISMATCH]") << '\n';
+
+  CscMatrix<double> csc(matrix);
+  double cscmv =
+      BestSeconds(kRepeats, [&] { Multiply(csc, x.data(), y.data()); });
+  ok = CheckSpmv(matrix, x, y);
+  std::cout << "  CSC MV  " << cscmv * 1e3 << " ms, "
+            << 2.0 * nnz / cscmv * 1e-9 << " GFLOP/s"
+            << (ok ? "" : "  [MISMATCH]") << '\n';
+
+  DynMatrix<double> dense(matrix.Columns(), spmm_width, 0.5);
+  DynMatrix<double> out;
+  double spmm = BestSeconds(kRepeats, [&] { out = matrix * dense; });
+  std::cout << "  SpMM    " << spmm * 1e3 << " ms (k=" << spmm_width << "), "
+            << 2.0 * nnz * spmm_width / spmm * 1e-9 << " GFLOP/s\n";
+
+  if (run_spgemm) {
+    CsrMatrix<double> product;
+    double spgemm = BestSeconds(1, [&] { product = matrix * matrix; });
+    std::cout << "  SpGEMM  " << spgemm * 1e3
+              << " ms, nnz(A*A)=" << product.NonZeros() << '\n';
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 18;
+  size_t per_row = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+  std::mt19937_64 gen(42);
+  std::cout << "threads=" << matrix_kernels::WorkerCount() << '\n';
+  Run("banded", Banded(size, per_row / 2), 16, true);
+  Run("random", Random(size, per_row, gen), 16, size <= (1 << 18));
+  Run("power-law", PowerLaw(size, per_row, gen), 16, size <= (1 << 18));
+  return 0;
+}
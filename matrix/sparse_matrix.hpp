@@ -0,0 +1,451 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "dyn_matrix.hpp"
+#include "kernels.hpp"
+#include "matrix.hpp"
+
+template <typename T>
+struct Triplet {
+  size_t row;
+  size_t column;
+  T value;
+};
+
+namespace sparse_detail {
+
+// Entries of major index i (a row for CSR, a column for CSC) live in
+// [offsets[i], offsets[i + 1]) of indices/values, sorted by minor index.
+template <typename T>
+struct Compressed {
+  std::vector<size_t> offsets;
+  std::vector<size_t> indices;
+  std::vector<T> values;
+};
+
+// Sorts (major, minor, value) entries and sums duplicates.
+template <typename T>
+Compressed<T> Compress(size_t majors, std::vector<Triplet<T>> entries) {
+  std::sort(entries.begin(), entries.end(),
+            [](const Triplet<T>& lhs, const Triplet<T>& rhs) {
+              return lhs.row != rhs.row ? lhs.row < rhs.row
+                                        : lhs.column < rhs.column;
+            });
+  Compressed<T> result;
+  result.offsets.assign(majors + 1, 0);
+  result.indices.reserve(entries.size());
+  result.values.reserve(entries.size());
+  for (size_t iii = 0; iii < entries.size(); ++iii) {
+    const Triplet<T>& entry = entries[iii];
+    if (entry.row >= majors) {
+      throw std::out_of_range("sparse matrix: index out of range");
+    }
+    if (iii > 0 && entry.row == entries[iii - 1].row &&
+        entry.column == entries[iii - 1].column) {
+      result.values.back() += entry.value;
+      continue;
+    }
+    result.indices.push_back(entry.column);
+    result.values.push_back(entry.value);
+    ++result.offsets[entry.row + 1];
+  }
+  for (size_t iii = 0; iii < majors; ++iii) {
+    result.offsets[iii + 1] += result.offsets[iii];
+  }
+  return result;
+}
+
+// Re-compresses along the other dimension in O(nnz) (counting sort); the
+// output stays sorted by minor index because majors are visited in order.
+template <typename T>
+Compressed<T> Transpose(const Compressed<T>& source, size_t minors) {
+  Compressed<T> result;
+  result.offsets.assign(minors + 1, 0);
+  result.indices.resize(source.indices.size());
+  result.values.resize(source.values.size());
+  for (size_t index : source.indices) {
+    ++result.offsets[index + 1];
+  }
+  for (size_t iii = 0; iii < minors; ++iii) {
+    result.offsets[iii + 1] += result.offsets[iii];
+  }
+  std::vector<size_t> next(result.offsets.begin(), result.offsets.end() - 1);
+  for (size_t major = 0; major + 1 < source.offsets.size(); ++major) {
+    for (size_t ppp = source.offsets[major]; ppp < source.offsets[major + 1];
+         ++ppp) {
+      size_t pos = next[source.indices[ppp]]++;
+      result.indices[pos] = major;
+      result.values[pos] = source.values[ppp];
+    }
+  }
+  return result;
+}
+
+template <typename T>
+Compressed<T> FromDenseRows(MatrixView<const T> dense) {
+  Compressed<T> result;
+  result.offsets.assign(dense.Rows() + 1, 0);
+  for (size_t iii = 0; iii < dense.Rows(); ++iii) {
+    for (size_t jjj = 0; jjj < dense.Columns(); ++jjj) {
+      if (dense(iii, jjj) != T()) {
+        result.indices.push_back(jjj);
+        result.values.push_back(dense(iii, jjj));
+      }
+    }
+    result.offsets[iii + 1] = result.indices.size();
+  }
+  return result;
+}
+
+template <typename T>
+T Find(const Compressed<T>& storage, size_t major, size_t minor) {
+  auto begin = storage.indices.begin() + storage.offsets[major];
+  auto end = storage.indices.begin() + storage.offsets[major + 1];
+  auto found = std::lower_bound(begin, end, minor);
+  if (found == end || *found != minor) {
+    return T();
+  }
+  return storage.values[found - storage.indices.begin()];
+}
+
+}  // namespace sparse_detail
+
+template <typename T>
+class CscMatrix;
+
+// Compressed sparse row matrix.
+template <typename T = int64_t>
+class CsrMatrix {
+ private:
+  size_t rows_ = 0;
+  size_t columns_ = 0;
+  sparse_detail::Compressed<T> storage_;
+
+ public:
+  CsrMatrix() : storage_{{0}, {}, {}} {}
+
+  CsrMatrix(size_t rows, size_t columns)
+      : rows_(rows), columns_(columns), storage_{{}, {}, {}} {
+    storage_.offsets.assign(rows + 1, 0);
+  }
+
+  CsrMatrix(size_t rows, size_t columns, sparse_detail::Compressed<T> storage)
+      : rows_(rows), columns_(columns), storage_(std::move(storage)) {
+    if (storage_.offsets.size() != rows + 1 ||
+        storage_.indices.size() != storage_.values.size() ||
+        storage_.offsets.back() != storage_.indices.size()) {
+      throw std::invalid_argument("CsrMatrix: inconsistent storage");
+    }
+  }
+
+  static CsrMatrix FromTriplets(size_t rows, size_t columns,
+                                std::vector<Triplet<T>> triplets) {
+    for (const auto& triplet : triplets) {
+      if (triplet.column >= columns) {
+        throw std::out_of_range("CsrMatrix: column out of range");
+      }
+    }
+    return CsrMatrix(rows, columns,
+                     sparse_detail::Compress(rows, std::move(triplets)));
+  }
+
+  static CsrMatrix FromDense(MatrixView<const T> dense) {
+    return CsrMatrix(dense.Rows(), dense.Columns(),
+                     sparse_detail::FromDenseRows(dense));
+  }
+
+  template <size_t N, size_t M>
+  static CsrMatrix FromDense(const Matrix<N, M, T>& dense) {
+    return FromDense(dense.View());
+  }
+
+  explicit CsrMatrix(const CscMatrix<T>& other);
+
+  size_t Rows() const { return rows_; }
+  size_t Columns() const { return columns_; }
+  size_t NonZeros() const { return storage_.indices.size(); }
+  const std::vector<size_t>& RowPtr() const { return storage_.offsets; }
+  const std::vector<size_t>& ColIdx() const { return storage_.indices; }
+  const std::vector<T>& Values() const { return storage_.values; }
+  const sparse_detail::Compressed<T>& Storage() const { return storage_; }
+
+  T operator()(size_t row, size_t column) const {
+    return sparse_detail::Find(storage_, row, column);
+  }
+
+  CsrMatrix Transposed() const {
+    return CsrMatrix(columns_, rows_,
+                     sparse_detail::Transpose(storage_, columns_));
+  }
+
+  DynMatrix<T> ToDense() const {
+    DynMatrix<T> dense(rows_, columns_);
+    for (size_t iii = 0; iii < rows_; ++iii) {
+      for (size_t ppp = storage_.offsets[iii]; ppp < storage_.offsets[iii + 1];
+           ++ppp) {
+        dense(iii, storage_.indices[ppp]) = storage_.values[ppp];
+      }
+    }
+    return dense;
+  }
+};
+
+// Compressed sparse column matrix.
+template <typename T = int64_t>
+class CscMatrix {
+ private:
+  size_t rows_ = 0;
+  size_t columns_ = 0;
+  sparse_detail::Compressed<T> storage_;
+
+ public:
+  CscMatrix() : storage_{{0}, {}, {}} {}
+
+  CscMatrix(size_t rows, size_t columns)
+      : rows_(rows), columns_(columns), storage_{{}, {}, {}} {
+    storage_.offsets.assign(columns + 1, 0);
+  }
+
+  CscMatrix(size_t rows, size_t columns, sparse_detail::Compressed<T> storage)
+      : rows_(rows), columns_(columns), storage_(std::move(storage)) {
+    if (storage_.offsets.size() != columns + 1 ||
+        storage_.indices.size() != storage_.values.size() ||
+        storage_.offsets.back() != storage_.indices.size()) {
+      throw std::invalid_argument("CscMatrix: inconsistent storage");
+    }
+  }
+
+  static CscMatrix FromTriplets(size_t rows, size_t columns,
+                                std::vector<Triplet<T>> triplets) {
+    for (auto& triplet : triplets) {
+      if (triplet.row >= rows) {
+        throw std::out_of_range("CscMatrix: row out of range");
+      }
+      std::swap(triplet.row, triplet.column);
+    }
+    return CscMatrix(rows, columns,
+                     sparse_detail::Compress(columns, std::move(triplets)));
+  }
+
+  static CscMatrix FromDense(MatrixView<const T> dense) {
+    return CscMatrix(CsrMatrix<T>::FromDense(dense));
+  }
+
+  template <size_t N, size_t M>
+  static CscMatrix FromDense(const Matrix<N, M, T>& dense) {
+    return FromDense(dense.View());
+  }
+
+  explicit CscMatrix(const CsrMatrix<T>& other)
+      : CscMatrix(other.Rows(), other.Columns(),
+                  sparse_detail::Transpose(other.Storage(), other.Columns())) {}
+
+  size_t Rows() const { return rows_; }
+  size_t Columns() const { return columns_; }
+  size_t NonZeros() const { return storage_.indices.size(); }
+  const std::vector<size_t>& ColPtr() const { return storage_.offsets; }
+  const std::vector<size_t>& RowIdx() const { return storage_.indices; }
+  const std::vector<T>& Values() const { return storage_.values; }
+  const sparse_detail::Compressed<T>& Storage() const { return storage_; }
+
+  T operator()(size_t row, size_t column) const {
+    return sparse_detail::Find(storage_, column, row);
+  }
+
+  DynMatrix<T> ToDense() const { return CsrMatrix<T>(*this).ToDense(); }
+};
+
+template <typename T>
+CsrMatrix<T>::CsrMatrix(const CscMatrix<T>& other)
+    : CsrMatrix(other.Rows(), other.Columns(),
+                sparse_detail::Transpose(other.Storage(), other.Rows())) {}
+
+// y = A * x (SpMV), rows split across threads by non-zero count.
+template <typename T>
+void Multiply(const CsrMatrix<T>& first, const T* x, T* y) {
+  const auto& row_ptr = first.RowPtr();
+  const size_t* col_idx = first.ColIdx().data();
+  const T* values = first.Values().data();
+  matrix_kernels::ParallelForWeighted(row_ptr, [&](size_t begin, size_t end) {
+    for (size_t iii = begin; iii < end; ++iii) {
+      T sum = T();
+      for (size_t ppp = row_ptr[iii]; ppp < row_ptr[iii + 1]; ++ppp) {
+        sum += values[ppp] * x[col_idx[ppp]];
+      }
+      y[iii] = sum;
+    }
+  });
+}
+
+// y = A * x for column storage: every thread scatters its column range into
+// a private accumulator, then the partial results are summed row-parallel.
+template <typename T>
+void Multiply(const CscMatrix<T>& first, const T* x, T* y) {
+  const auto& col_ptr = first.ColPtr();
+  const size_t* row_idx = first.RowIdx().data();
+  const T* values = first.Values().data();
+  size_t rows = first.Rows();
+  size_t threads = std::min(
+      matrix_kernels::ThreadsFor(first.NonZeros() + first.Columns()),
+      std::max<size_t>(first.Columns(), 1));
+  std::vector<size_t> bounds(threads + 1);
+  for (size_t ttt = 0; ttt <= threads; ++ttt) {
+    bounds[ttt] = first.Columns() * ttt / threads;
+  }
+  std::vector<std::vector<T>> partial(threads);
+  matrix_kernels::ParallelRanges(bounds, [&](size_t begin, size_t end) {
+    size_t slot = std::upper_bound(bounds.begin(), bounds.end(), begin) -
+                  bounds.begin() - 1;
+    std::vector<T>& acc = partial[slot];
+    acc.assign(rows, T());
+    for (size_t jjj = begin; jjj < end; ++jjj) {
+      for (size_t ppp = col_ptr[jjj]; ppp < col_ptr[jjj + 1]; ++ppp) {
+        acc[row_idx[ppp]] += values[ppp] * x[jjj];
+      }
+    }
+  });
+  // Every row sums one partial result per thread.
+  matrix_kernels::ParallelFor(
+      rows,
+      [&](size_t begin, size_t end) {
+        for (size_t iii = begin; iii < end; ++iii) {
+          T sum = T();
+          for (const auto& acc : partial) {
+            if (!acc.empty()) {
+              sum += acc[iii];
+            }
+          }
+          y[iii] = sum;
+        }
+      },
+      threads);
+}
+
+template <typename T>
+std::vector<T> operator*(const CsrMatrix<T>& first, const std::vector<T>& x) {
+  if (x.size() != first.Columns()) {
+    throw std::invalid_argument("SpMV: shape mismatch");
+  }
+  std::vector<T> y(first.Rows());
+  Multiply(first, x.data(), y.data());
+  return y;
+}
+
+template <typename T>
+std::vector<T> operator*(const CscMatrix<T>& first, const std::vector<T>& x) {
+  if (x.size() != first.Columns()) {
+    throw std::invalid_argument("SpMV: shape mismatch");
+  }
+  std::vector<T> y(first.Rows());
+  Multiply(first, x.data(), y.data());
+  return y;
+}
+
+// result += A * B with a dense B (SpMM); each non-zero a(i, p) adds a scaled
+// row p of B to row i of the result, which vectorizes along the row.
+template <typename T>
+void MultiplyAdd(const CsrMatrix<T>& first, MatrixView<const T> second,
+                 MatrixView<T> result) {
+  if (first.Columns() != second.Rows() || result.Rows() != first.Rows() ||
+      result.Columns() != second.Columns()) {
+    throw std::invalid_argument("SpMM: shape mismatch");
+  }
+  const auto& row_ptr = first.RowPtr();
+  const size_t* col_idx = first.ColIdx().data();
+  const T* values = first.Values().data();
+  size_t width = second.Columns();
+  matrix_kernels::ParallelForWeighted(row_ptr, [&](size_t begin, size_t end) {
+    for (size_t iii = begin; iii < end; ++iii) {
+      T* out_row = result.Data() + iii * result.Stride();
+      for (size_t ppp = row_ptr[iii]; ppp < row_ptr[iii + 1]; ++ppp) {
+        const T value = values[ppp];
+        const T* in_row = second.Data() + col_idx[ppp] * second.Stride();
+        for (size_t jjj = 0; jjj < width; ++jjj) {
+          out_row[jjj] += value * in_row[jjj];
+        }
+      }
+    }
+  });
+}
+
+template <typename T>
+DynMatrix<T> operator*(const CsrMatrix<T>& first, const DynMatrix<T>& second) {
+  DynMatrix<T> result(first.Rows(), second.Columns());
+  MultiplyAdd(first, second.View(), result.View());
+  return result;
+}
+
+// C = A * B for two CSR matrices (SpGEMM, Gustavson's row-by-row algorithm).
+// A symbolic pass sizes every output row, then a numeric pass fills the rows
+// in place, so both passes run in parallel without synchronization.
+template <typename T>
+CsrMatrix<T> operator*(const CsrMatrix<T>& first, const CsrMatrix<T>& second) {
+  if (first.Columns() != second.Rows()) {
+    throw std::invalid_argument("SpGEMM: shape mismatch");
+  }
+  const size_t kUnset = SIZE_MAX;
+  const auto& a_ptr = first.RowPtr();
+  const auto& a_idx = first.ColIdx();
+  const auto& a_val = first.Values();
+  const auto& b_ptr = second.RowPtr();
+  const auto& b_idx = second.ColIdx();
+  const auto& b_val = second.Values();
+  size_t rows = first.Rows();
+  size_t columns = second.Columns();
+
+  sparse_detail::Compressed<T> storage;
+  storage.offsets.assign(rows + 1, 0);
+  matrix_kernels::ParallelForWeighted(a_ptr, [&](size_t begin, size_t end) {
+    std::vector<size_t> marker(columns, kUnset);
+    for (size_t iii = begin; iii < end; ++iii) {
+      size_t count = 0;
+      for (size_t ppp = a_ptr[iii]; ppp < a_ptr[iii + 1]; ++ppp) {
+        size_t row = a_idx[ppp];
+        for (size_t qqq = b_ptr[row]; qqq < b_ptr[row + 1]; ++qqq) {
+          if (marker[b_idx[qqq]] != iii) {
+            marker[b_idx[qqq]] = iii;
+            ++count;
+          }
+        }
+      }
+      storage.offsets[iii + 1] = count;
+    }
+  });
+  for (size_t iii = 0; iii < rows; ++iii) {
+    storage.offsets[iii + 1] += storage.offsets[iii];
+  }
+  storage.indices.resize(storage.offsets.back());
+  storage.values.resize(storage.offsets.back());
+
+  matrix_kernels::ParallelForWeighted(a_ptr, [&](size_t begin, size_t end) {
+    std::vector<size_t> marker(columns, kUnset);
+    std::vector<T> acc(columns);
+    for (size_t iii = begin; iii < end; ++iii) {
+      size_t start = storage.offsets[iii];
+      size_t pos = start;
+      for (size_t ppp = a_ptr[iii]; ppp < a_ptr[iii + 1]; ++ppp) {
+        size_t row = a_idx[ppp];
+        const T value = a_val[ppp];
+        for (size_t qqq = b_ptr[row]; qqq < b_ptr[row + 1]; ++qqq) {
+          size_t column = b_idx[qqq];
+          if (marker[column] != iii) {
+            marker[column] = iii;
+            storage.indices[pos++] = column;
+            acc[column] = value * b_val[qqq];
+          } else {
+            acc[column] += value * b_val[qqq];
+          }
+        }
+      }
+      std::sort(storage.indices.begin() + start, storage.indices.begin() + pos);
+      for (size_t ppp = start; ppp < pos; ++ppp) {
+        storage.values[ppp] = acc[storage.indices[ppp]];
+      }
+    }
+  });
+  return CsrMatrix<T>(rows, columns, std::move(storage));
+}
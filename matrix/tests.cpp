@@ -0,0 +1,982 @@
+#include "matrix.hpp"
+#include "mapped_matrix.hpp"
+#include "sparse_matrix.hpp"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Small integers keep every sum exact in float, double and the integer
+// types alike, so results compare with == against the reference loops.
+template <typename T>
+DynMatrix<T> RandomMatrix(size_t rows, size_t cols, std::mt19937_64& gen,
+                          int bound = 4) {
+  std::uniform_int_distribution<int> value(-bound, bound);
+  DynMatrix<T> result(rows, cols);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      result(i, j) = T(value(gen));
+    }
+  }
+  return result;
+}
+
+// Roughly `density` of the entries non-zero.
+DynMatrix<int64_t> RandomSparse(size_t rows, size_t cols, double density,
+                                std::mt19937_64& gen) {
+  std::bernoulli_distribution keep(density);
+  std::uniform_int_distribution<int> value(1, 9);
+  DynMatrix<int64_t> result(rows, cols);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      if (keep(gen)) {
+        result(i, j) = value(gen);
+      }
+    }
+  }
+  return result;
+}
+
+template <typename Out, typename In>
+DynMatrix<Out> ReferenceMultiply(const DynMatrix<In>& a,
+                                 const DynMatrix<In>& b) {
+  DynMatrix<Out> c(a.Rows(), b.Columns());
+  for (size_t i = 0; i < a.Rows(); ++i) {
+    for (size_t j = 0; j < b.Columns(); ++j) {
+      Out sum = Out();
+      for (size_t p = 0; p < a.Columns(); ++p) {
+        sum += static_cast<Out>(a(i, p)) * static_cast<Out>(b(p, j));
+      }
+      c(i, j) = sum;
+    }
+  }
+  return c;
+}
+
+template <typename T>
+DynMatrix<T> ReferenceMultiply(const DynMatrix<T>& a, const DynMatrix<T>& b) {
+  return ReferenceMultiply<T, T>(a, b);
+}
+
+template <size_t N, size_t M, typename T>
+Matrix<N, M, T> RandomFixed(std::mt19937_64& gen, int bound = 4) {
+  return Matrix<N, M, T>(RandomMatrix<T>(N, M, gen, bound));
+}
+
+template <typename T>
+void ExpectGemmMatchesReference(size_t n, size_t m, size_t k,
+                                std::mt19937_64& gen) {
+  DynMatrix<T> a = RandomMatrix<T>(n, m, gen);
+  DynMatrix<T> b = RandomMatrix<T>(m, k, gen);
+  DynMatrix<T> c(n, k);
+  matrix_kernels::Gemm(n, m, k, a.Data(), a.Stride(), b.Data(), b.Stride(),
+                       c.Data(), c.Stride());
+  EXPECT_TRUE(c == ReferenceMultiply(a, b)) << n << "x" << m << "x" << k;
+}
+
+DynMatrix<double> RandomReal(size_t rows, size_t cols, std::mt19937_64& gen) {
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+  DynMatrix<double> result(rows, cols);
+  for (size_t i = 0; i < rows; ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      result(i, j) = value(gen);
+    }
+  }
+  return result;
+}
+
+double MaxDifference(const DynMatrix<double>& lhs,
+                     const DynMatrix<double>& rhs) {
+  double result = 0;
+  for (size_t i = 0; i < lhs.Rows(); ++i) {
+    for (size_t j = 0; j < lhs.Columns(); ++j) {
+      result = std::max(result, std::abs(lhs(i, j) - rhs(i, j)));
+    }
+  }
+  return result;
+}
+
+DynMatrix<double> Identity(size_t size) {
+  DynMatrix<double> result(size, size);
+  for (size_t i = 0; i < size; ++i) {
+    result(i, i) = 1;
+  }
+  return result;
+}
+
+template <typename M>
+concept HasLu = requires(const M& m) { m.Lu(); };
+template <typename M>
+concept HasInverse = requires(const M& m) { m.Inverse(); };
+template <typename M>
+concept HasCholesky = requires(const M& m) { m.Cholesky(); };
+
+// a * b mod p with every product reduced through 128 bits.
+template <size_t N>
+Matrix<N, N, int64_t> NaiveMultiplyMod(const Matrix<N, N, int64_t>& a,
+                                       const Matrix<N, N, int64_t>& b,
+                                       int64_t modulus) {
+  Matrix<N, N, int64_t> c;
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      __int128 sum = 0;
+      for (size_t p = 0; p < N; ++p) {
+        sum = (sum + __int128(a(i, p)) * b(p, j)) % modulus;
+      }
+      c(i, j) = static_cast<int64_t>(sum);
+    }
+  }
+  return c;
+}
+
+template <size_t N>
+Matrix<N, N, int64_t> NaivePowMod(Matrix<N, N, int64_t> base, uint64_t power,
+                                  int64_t modulus) {
+  for (size_t i = 0; i < N; ++i) {
+    for (size_t j = 0; j < N; ++j) {
+      base(i, j) = static_cast<int64_t>(
+          (__int128(base(i, j)) % modulus + modulus) % modulus);
+    }
+  }
+  Matrix<N, N, int64_t> result;
+  for (size_t i = 0; i < N; ++i) {
+    result(i, i) = 1 % modulus;
+  }
+  for (uint64_t step = 0; step < power; ++step) {
+    result = NaiveMultiplyMod(result, base, modulus);
+  }
+  return result;
+}
+
+// A per-process path under the gtest temp directory, removed on scope exit.
+class TempFile {
+ public:
+  explicit TempFile(const std::string& name)
+      : path_(testing::TempDir() + "matrix_tests_" +
+              std::to_string(::getpid()) + "_" + name) {}
+  ~TempFile() { std::remove(path_.c_str()); }
+
+  const std::string& Path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+void OverwriteBytes(const std::string& path, size_t offset, const void* bytes,
+                    size_t size) {
+  int fd = ::open(path.c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(::pwrite(fd, bytes, size, static_cast<off_t>(offset)),
+            static_cast<ssize_t>(size));
+  ::close(fd);
+}
+
+void Truncate(const std::string& path, size_t size) {
+  ASSERT_EQ(::truncate(path.c_str(), static_cast<off_t>(size)), 0);
+}
+
+int64_t Clamp(__int128 value) {
+  if (value > std::numeric_limits<int64_t>::max()) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  if (value < std::numeric_limits<int64_t>::min()) {
+    return std::numeric_limits<int64_t>::min();
+  }
+  return static_cast<int64_t>(value);
+}
+
+}  // namespace
+
+TEST(Moves, HandOverTheBuffer) {
+  EXPECT_TRUE((std::is_nothrow_move_constructible_v<Matrix<3, 4, int64_t>>));
+  EXPECT_TRUE((std::is_nothrow_move_assignable_v<Matrix<3, 4, int64_t>>));
+  EXPECT_TRUE((std::is_nothrow_move_constructible_v<Matrix<3, 3, int64_t>>));
+  EXPECT_TRUE((std::is_nothrow_move_assignable_v<Matrix<3, 3, int64_t>>));
+
+  Matrix<3, 4, int64_t> source(7);
+  const int64_t* data = source.Data();
+  Matrix<3, 4, int64_t> target(std::move(source));
+  EXPECT_EQ(target.Data(), data);
+  EXPECT_EQ(target, (Matrix<3, 4, int64_t>(7)));
+  // A moved-from matrix can be assigned to and used again.
+  source = Matrix<3, 4, int64_t>(2);
+  source(2, 3) = 5;
+  EXPECT_EQ(source(2, 3), 5);
+
+  Matrix<3, 3, int64_t> square(2);
+  Matrix<3, 3, int64_t> other(9);
+  other = std::move(square);
+  EXPECT_EQ(other, (Matrix<3, 3, int64_t>(2)));
+  square = other;
+  EXPECT_EQ(square.Trace(), 6);
+
+  // Reallocation moves rather than copies, so the buffers survive.
+  std::vector<Matrix<3, 3, int64_t>> matrices(1, other);
+  const int64_t* first = matrices[0].Data();
+  matrices.reserve(matrices.capacity() + 8);
+  EXPECT_EQ(matrices[0].Data(), first);
+}
+
+TEST(Moves, ToDynHandsOverTheBuffer) {
+  Matrix<2, 5, double> wide(1.5);
+  const double* data = wide.Data();
+  DynMatrix<double> dyn = std::move(wide).ToDyn();
+  EXPECT_EQ(dyn.Data(), data);
+  EXPECT_EQ(dyn.Rows(), 2u);
+  EXPECT_EQ(dyn.Columns(), 5u);
+  EXPECT_EQ(dyn(1, 4), 1.5);
+  Matrix<2, 5, double> back(std::move(dyn));
+  EXPECT_EQ(back.Data(), data);
+  EXPECT_EQ(back, (Matrix<2, 5, double>(1.5)));
+
+  Matrix<4, 4, int64_t> square(3);
+  DynMatrix<int64_t> dyn_square = std::move(square).ToDyn();
+  EXPECT_EQ(dyn_square(3, 3), 3);
+}
+
+TEST(Blocks, ViewMatchesCopiedSubmatrix) {
+  std::mt19937_64 gen(26);
+  DynMatrix<int64_t> parent = RandomMatrix<int64_t>(11, 13, gen, 100);
+  MatrixView<int64_t> block = parent.Block(3, 2, 5, 7);
+  EXPECT_EQ(block.Data(), &parent(3, 2));
+  EXPECT_EQ(block.Stride(), 13u);
+  DynMatrix<int64_t> copy(block);
+  ASSERT_EQ(copy.Rows(), 5u);
+  ASSERT_EQ(copy.Columns(), 7u);
+  for (size_t i = 0; i < 5; ++i) {
+    for (size_t j = 0; j < 7; ++j) {
+      EXPECT_EQ(copy(i, j), parent(3 + i, 2 + j));
+    }
+  }
+  // A block of a block keeps the parent's stride.
+  const DynMatrix<int64_t>& const_parent = parent;
+  MatrixView<const int64_t> inner =
+      const_parent.Block(3, 2, 5, 7).Block(1, 4, 3, 2);
+  EXPECT_EQ(inner.Stride(), 13u);
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = 0; j < 2; ++j) {
+      EXPECT_EQ(inner(i, j), copy(1 + i, 4 + j));
+    }
+  }
+
+  Matrix<6, 4, int64_t> fixed(3);
+  fixed(4, 3) = 8;
+  EXPECT_EQ(fixed.View().Block(2, 1, 3, 3)(2, 2), 8);
+}
+
+TEST(Blocks, WritesLandInParent) {
+  std::mt19937_64 gen(27);
+  DynMatrix<int64_t> parent = RandomMatrix<int64_t>(9, 10, gen, 100);
+  DynMatrix<int64_t> before = parent;
+  MatrixView<int64_t> block = parent.Block(2, 3, 4, 5);
+  for (size_t i = 0; i < 4; ++i) {
+    for (size_t j = 0; j < 5; ++j) {
+      block(i, j) = 1000 + static_cast<int64_t>(i * 10 + j);
+    }
+  }
+  for (size_t i = 0; i < 9; ++i) {
+    for (size_t j = 0; j < 10; ++j) {
+      bool inside = i >= 2 && i < 6 && j >= 3 && j < 8;
+      int64_t expected = inside ? 1000 + static_cast<int64_t>(
+                                             (i - 2) * 10 + (j - 3))
+                                : before(i, j);
+      EXPECT_EQ(parent(i, j), expected) << i << ", " << j;
+    }
+  }
+}
+
+TEST(Blocks, MultiplyAddOnStridedBlocks) {
+  std::mt19937_64 gen(28);
+  DynMatrix<int64_t> a = RandomMatrix<int64_t>(20, 17, gen, 50);
+  DynMatrix<int64_t> b = RandomMatrix<int64_t>(19, 23, gen, 50);
+  DynMatrix<int64_t> c = RandomMatrix<int64_t>(12, 14, gen, 50);
+  DynMatrix<int64_t> a_copy(a.Block(2, 3, 9, 6));
+  DynMatrix<int64_t> b_copy(b.Block(4, 5, 6, 8));
+  DynMatrix<int64_t> expected = c;
+  DynMatrix<int64_t> product = a_copy * b_copy;
+  for (size_t i = 0; i < 9; ++i) {
+    for (size_t j = 0; j < 8; ++j) {
+      expected(1 + i, 2 + j) += product(i, j);
+    }
+  }
+  const DynMatrix<int64_t>& const_a = a;
+  const DynMatrix<int64_t>& const_b = b;
+  MultiplyAdd(const_a.Block(2, 3, 9, 6), const_b.Block(4, 5, 6, 8),
+              c.Block(1, 2, 9, 8));
+  EXPECT_EQ(c, expected);
+  EXPECT_THROW(MultiplyAdd(const_a.Block(2, 3, 9, 6),
+                           const_b.Block(4, 5, 7, 8), c.Block(1, 2, 9, 8)),
+               std::invalid_argument);
+}
+
+// Panel widths are 64, so the sizes cover one, several and ragged panels.
+const size_t kFactorSizes[] = {1, 5, 64, 65, 150};
+
+TEST(Factorizations, LuReconstructsPermutedMatrix) {
+  std::mt19937_64 gen(280);
+  for (size_t n : kFactorSizes) {
+    DynMatrix<double> a = RandomReal(n, n, gen);
+    LuDecomposition<double> lu(a);
+    ASSERT_FALSE(lu.IsSingular());
+    DynMatrix<double> lower = Identity(n);
+    DynMatrix<double> upper(n, n);
+    DynMatrix<double> permuted(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        (j < i ? lower(i, j) : upper(i, j)) = lu.Packed()(i, j);
+        permuted(i, j) = a(lu.Permutation()[i], j);
+      }
+    }
+    EXPECT_LT(MaxDifference(lower * upper, permuted), 1e-12 * n) << n;
+  }
+  DynMatrix<double> singular(3, 3, 1.0);
+  EXPECT_TRUE(LuDecomposition<double>(singular).IsSingular());
+  EXPECT_THROW(LuDecomposition<double>(singular).Solve(std::vector<double>(3)),
+               std::runtime_error);
+}
+
+TEST(Factorizations, CholeskyReconstructs) {
+  std::mt19937_64 gen(281);
+  for (size_t n : kFactorSizes) {
+    DynMatrix<double> b = RandomReal(n, n, gen);
+    DynMatrix<double> a = b * b.Transposed() + Identity(n) * double(n);
+    CholeskyDecomposition<double> cholesky(a);
+    const DynMatrix<double>& lower = cholesky.L();
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = i + 1; j < n; ++j) {
+        EXPECT_EQ(lower(i, j), 0);
+      }
+    }
+    EXPECT_LT(MaxDifference(lower * lower.Transposed(), a), 1e-12 * n) << n;
+  }
+  DynMatrix<double> indefinite = Identity(3);
+  indefinite(2, 2) = -1;
+  EXPECT_THROW(CholeskyDecomposition<double>{indefinite}, std::domain_error);
+}
+
+TEST(Factorizations, QrIsOrthogonal) {
+  std::mt19937_64 gen(282);
+  const size_t shapes[][2] = {{1, 1}, {7, 5}, {64, 64}, {150, 70}, {130, 130}};
+  for (const auto& shape : shapes) {
+    size_t rows = shape[0];
+    size_t cols = shape[1];
+    DynMatrix<double> a = RandomReal(rows, cols, gen);
+    QrDecomposition<double> qr(a);
+    DynMatrix<double> q_transposed = Identity(rows);
+    qr.ApplyQt(q_transposed.View());
+    EXPECT_LT(MaxDifference(q_transposed * q_transposed.Transposed(),
+                            Identity(rows)),
+              1e-12 * rows);
+    // Q^T A is R on top of zeros.
+    DynMatrix<double> rotated = q_transposed * a;
+    DynMatrix<double> r = qr.R();
+    DynMatrix<double> expected(rows, cols);
+    for (size_t i = 0; i < cols; ++i) {
+      std::copy(r.RowData(i), r.RowData(i) + cols, expected.RowData(i));
+    }
+    EXPECT_LT(MaxDifference(rotated, expected), 1e-12 * rows);
+  }
+}
+
+TEST(Factorizations, SolveResidualsAndInverse) {
+  std::mt19937_64 gen(283);
+  const size_t kN = 70;
+  Matrix<kN, kN, double> a(RandomReal(kN, kN, gen));
+  for (size_t i = 0; i < kN; ++i) {
+    a(i, i) += 4;
+  }
+  Matrix<kN, 3, double> rhs(RandomReal(kN, 3, gen));
+  Matrix<kN, 3, double> x = a.Solve(rhs);
+  EXPECT_LT(MaxDifference(DynMatrix<double>((a * x).View()),
+                          DynMatrix<double>(rhs.View())),
+            1e-11);
+  EXPECT_LT(MaxDifference(DynMatrix<double>((a.Inverse() * a).View()),
+                          Identity(kN)),
+            1e-11);
+  EXPECT_LT(MaxDifference(DynMatrix<double>((a * a.Inverse()).View()),
+                          Identity(kN)),
+            1e-11);
+
+  DynMatrix<double> rhs_dyn(rhs.View());
+  DynMatrix<double> from_qr = a.Qr().Solve(rhs_dyn);
+  EXPECT_LT(MaxDifference(from_qr, DynMatrix<double>(x.View())), 1e-11);
+  double lu_det = a.Determinant();
+  EXPECT_NEAR(a.Qr().Determinant() / lu_det, 1.0, 1e-9);
+
+  Matrix<kN, kN, double> spd = a * a.Transposed();
+  Matrix<kN, 3, double> spd_x(spd.Cholesky().Solve(rhs_dyn));
+  EXPECT_LT(MaxDifference(DynMatrix<double>((spd * spd_x).View()), rhs_dyn),
+            1e-9);
+  EXPECT_NEAR(spd.Cholesky().Determinant() / (lu_det * lu_det), 1.0, 1e-9);
+}
+
+TEST(Factorizations, FloatingPointOnly) {
+  EXPECT_TRUE((HasLu<Matrix<3, 3, double>>));
+  EXPECT_TRUE((HasInverse<Matrix<3, 3, float>>));
+  EXPECT_TRUE((HasCholesky<Matrix<3, 3, double>>));
+  EXPECT_FALSE((HasLu<Matrix<3, 3, int64_t>>));
+  EXPECT_FALSE((HasInverse<Matrix<3, 3, int64_t>>));
+  EXPECT_FALSE((HasCholesky<Matrix<3, 3, int32_t>>));
+}
+
+TEST(Determinant, BareissIsExact) {
+  Matrix<3, 3, int64_t> a({{2, -3, 1}, {2, 0, -1}, {1, 4, 5}});
+  EXPECT_EQ(a.Determinant(), 49);
+  Matrix<3, 3, int64_t> swapped({{0, 1, 2}, {3, 4, 5}, {6, 7, 9}});
+  EXPECT_EQ(swapped.Determinant(), -3);
+  Matrix<3, 3, int64_t> singular({{1, 2, 3}, {2, 4, 6}, {0, 0, 1}});
+  EXPECT_EQ(singular.Determinant(), 0);
+  // a * d overflows int64 on its own, but the determinant is 1.
+  const int64_t kBig = int64_t(1) << 32;
+  Matrix<2, 2, int64_t> cancelling({{kBig, kBig - 1}, {kBig + 1, kBig}});
+  EXPECT_EQ(cancelling.Determinant(), 1);
+
+  std::mt19937_64 gen(284);
+  auto random = RandomFixed<6, 6, int64_t>(gen, 9);
+  Matrix<6, 6, double> real;
+  for (size_t i = 0; i < 6; ++i) {
+    for (size_t j = 0; j < 6; ++j) {
+      real(i, j) = double(random(i, j));
+    }
+  }
+  EXPECT_NEAR(double(random.Determinant()), real.Determinant(), 1e-6);
+}
+
+TEST(Determinant, OverflowThrows) {
+  const int64_t kBig = int64_t(1) << 40;
+  Matrix<2, 2, int64_t> huge({{kBig, -kBig}, {kBig, kBig}});
+  EXPECT_THROW(huge.Determinant(), std::overflow_error);
+  Matrix<3, 3, int32_t> narrow({{100000, 0, 0}, {0, 100000, 0}, {0, 0, 1}});
+  EXPECT_THROW(narrow.Determinant(), std::overflow_error);
+  Matrix<2, 2, int32_t> fits({{46340, 0}, {0, 46340}});
+  EXPECT_EQ(fits.Determinant(), 46340 * 46340);
+}
+
+TEST(Pow, MatchesRepeatedMultiplication) {
+  std::mt19937_64 gen(29);
+  auto a = RandomFixed<4, 4, int64_t>(gen, 3);
+  Matrix<4, 4, int64_t> expected;
+  for (size_t i = 0; i < 4; ++i) {
+    expected(i, i) = 1;
+  }
+  for (uint64_t power = 0; power <= 9; ++power) {
+    EXPECT_EQ(a.Pow(power), expected) << power;
+    expected = expected * a;
+  }
+}
+
+TEST(Pow, ModularMatchesNaive) {
+  // Around the switch from 64- to 128-bit accumulators at 2^32, and the
+  // largest prime below 2^63, where only a few products fit between
+  // reductions.
+  const int64_t kModuli[] = {1,
+                             2,
+                             1000000007,
+                             (int64_t(1) << 32) - 5,
+                             (int64_t(1) << 32) + 15,
+                             (int64_t(1) << 62) + 135,
+                             std::numeric_limits<int64_t>::max() - 24};
+  std::mt19937_64 gen(290);
+  std::uniform_int_distribution<int64_t> value(
+      std::numeric_limits<int64_t>::min() / 2,
+      std::numeric_limits<int64_t>::max());
+  for (int64_t modulus : kModuli) {
+    Matrix<5, 5, int64_t> a;
+    for (size_t i = 0; i < 5; ++i) {
+      for (size_t j = 0; j < 5; ++j) {
+        a(i, j) = value(gen);
+      }
+    }
+    ModularReduction<int64_t> policy{modulus};
+    for (uint64_t power : {0, 1, 2, 7, 16, 37}) {
+      EXPECT_EQ(a.Pow(power, policy), NaivePowMod(a, power, modulus))
+          << modulus << "^" << power;
+    }
+  }
+}
+
+TEST(Pow, RejectsNonPositiveModulus) {
+  Matrix<3, 3, int64_t> a(2);
+  EXPECT_THROW(a.Pow(5, ModularReduction<int64_t>{0}), std::invalid_argument);
+  EXPECT_THROW(a.Pow(5, ModularReduction<int64_t>{-7}),
+               std::invalid_argument);
+  EXPECT_THROW(a.Pow(0, ModularReduction<int64_t>{0}), std::invalid_argument);
+}
+
+TEST(Mapped, StoreMapRoundTrip) {
+  std::mt19937_64 gen(30);
+  // 37 x 53 against 16 x 8 tiles leaves partial tiles on both edges.
+  DynMatrix<double> original = RandomMatrix<double>(37, 53, gen, 1000);
+  TempFile file("round_trip");
+  StoreMatrix<double>(file.Path(), original.View(), 16, 8);
+
+  auto mapped = MappedMatrix<double>::Open(file.Path());
+  EXPECT_EQ(mapped.Rows(), 37u);
+  EXPECT_EQ(mapped.Columns(), 53u);
+  EXPECT_EQ(mapped.File().TileGridRows(), 3u);
+  EXPECT_EQ(mapped.File().TileGridColumns(), 7u);
+  EXPECT_EQ(mapped.ToDense(), original);
+
+  MatrixView<double> edge = mapped.Tile(2, 6);
+  ASSERT_EQ(edge.Rows(), 5u);
+  ASSERT_EQ(edge.Columns(), 5u);
+  for (size_t i = 0; i < edge.Rows(); ++i) {
+    for (size_t j = 0; j < edge.Columns(); ++j) {
+      EXPECT_EQ(edge(i, j), original(32 + i, 48 + j));
+    }
+  }
+}
+
+TEST(Mapped, WritesPersistAcrossOpens) {
+  TempFile file("writes");
+  {
+    auto mapped = MappedMatrix<int32_t>::Create(file.Path(), 19, 23, 8, 8);
+    for (size_t i = 0; i < 19; ++i) {
+      for (size_t j = 0; j < 23; ++j) {
+        mapped(i, j) = static_cast<int32_t>(i * 100 + j);
+      }
+    }
+    mapped.Flush();
+  }
+  const auto mapped = MappedMatrix<int32_t>::Open(file.Path());
+  for (size_t i = 0; i < 19; ++i) {
+    for (size_t j = 0; j < 23; ++j) {
+      EXPECT_EQ(mapped(i, j), static_cast<int32_t>(i * 100 + j));
+    }
+  }
+}
+
+TEST(Mapped, OutOfCoreMatchesInMemory) {
+  std::mt19937_64 gen(31);
+  // None of the dimensions is a multiple of its tile size.
+  DynMatrix<int64_t> a = RandomMatrix<int64_t>(45, 37, gen, 50);
+  DynMatrix<int64_t> b = RandomMatrix<int64_t>(37, 29, gen, 50);
+  TempFile a_file("ooc_a");
+  TempFile b_file("ooc_b");
+  TempFile c_file("ooc_c");
+  StoreMatrix<int64_t>(a_file.Path(), a.View(), 16, 12);
+  StoreMatrix<int64_t>(b_file.Path(), b.View(), 12, 8);
+
+  OutOfCoreMultiply<int64_t>(a_file.Path(), b_file.Path(), c_file.Path());
+  auto c = MappedMatrix<int64_t>::Open(c_file.Path());
+  EXPECT_EQ(c.File().TileRows(), 16u);
+  EXPECT_EQ(c.File().TileColumns(), 8u);
+  EXPECT_EQ(c.ToDense(), a * b);
+  EXPECT_EQ(c.ToDense(), (ReferenceMultiply<int64_t, int64_t>(a, b)));
+
+  // A single inner tile and a single output tile take the same path.
+  StoreMatrix<int64_t>(a_file.Path(), a.View(), 64, 64);
+  StoreMatrix<int64_t>(b_file.Path(), b.View(), 64, 64);
+  OutOfCoreMultiply<int64_t>(a_file.Path(), b_file.Path(), c_file.Path());
+  EXPECT_EQ(MappedMatrix<int64_t>::Open(c_file.Path()).ToDense(), a * b);
+}
+
+TEST(Mapped, OutOfCoreRejectsMismatches) {
+  std::mt19937_64 gen(32);
+  DynMatrix<double> a = RandomMatrix<double>(10, 12, gen);
+  DynMatrix<double> b = RandomMatrix<double>(12, 9, gen);
+  TempFile a_file("mismatch_a");
+  TempFile b_file("mismatch_b");
+  TempFile c_file("mismatch_c");
+  StoreMatrix<double>(a_file.Path(), a.View(), 4, 4);
+  StoreMatrix<double>(b_file.Path(), b.View(), 8, 4);
+  EXPECT_THROW(
+      OutOfCoreMultiply<double>(a_file.Path(), b_file.Path(), c_file.Path()),
+      std::invalid_argument);
+  StoreMatrix<double>(b_file.Path(), a.View(), 4, 4);
+  EXPECT_THROW(
+      OutOfCoreMultiply<double>(a_file.Path(), b_file.Path(), c_file.Path()),
+      std::invalid_argument);
+}
+
+TEST(Mapped, PrefetcherUsesOneThreadAndRethrows) {
+  std::vector<std::thread::id> loaders;
+  std::vector<size_t> slots;
+  {
+    mapped_detail::TilePrefetcher prefetcher(8, [&](size_t step, size_t slot) {
+      if (step == 5) {
+        throw std::runtime_error("load failed");
+      }
+      loaders.push_back(std::this_thread::get_id());
+      slots.push_back(slot);
+    });
+    for (size_t step = 0; step < 5; ++step) {
+      prefetcher.Acquire(step);
+      prefetcher.Release(step);
+    }
+    EXPECT_THROW(prefetcher.Acquire(5), std::runtime_error);
+  }
+  ASSERT_EQ(loaders.size(), 5u);
+  for (size_t i = 0; i < loaders.size(); ++i) {
+    EXPECT_EQ(loaders[i], loaders[0]);
+    EXPECT_EQ(slots[i], i & 1);
+  }
+  EXPECT_NE(loaders[0], std::this_thread::get_id());
+  // Abandoning the loop early stops and joins the loader.
+  mapped_detail::TilePrefetcher abandoned(1000, [](size_t, size_t) {});
+  abandoned.Acquire(0);
+}
+
+TEST(Mapped, CorruptOrTruncatedHeaderThrows) {
+  std::mt19937_64 gen(33);
+  DynMatrix<float> original = RandomMatrix<float>(20, 30, gen);
+  TempFile file("corrupt");
+  auto store = [&] {
+    StoreMatrix<float>(file.Path(), original.View(), 8, 8);
+  };
+
+  store();
+  EXPECT_NO_THROW(MatrixFile<float>::Open(file.Path()));
+  EXPECT_THROW(MatrixFile<double>::Open(file.Path()), std::runtime_error);
+
+  const char magic[8] = {'N', 'O', 'T', 'A', 'M', 'A', 'T', '!'};
+  OverwriteBytes(file.Path(), offsetof(MatrixFileHeader, magic), magic,
+                 sizeof(magic));
+  EXPECT_THROW(MatrixFile<float>::Open(file.Path()), std::runtime_error);
+
+  store();
+  uint64_t zero = 0;
+  OverwriteBytes(file.Path(), offsetof(MatrixFileHeader, tile_rows), &zero,
+                 sizeof(zero));
+  EXPECT_THROW(MatrixFile<float>::Open(file.Path()), std::runtime_error);
+
+  // Sizes whose product overflows must not pass the length check.
+  store();
+  uint64_t huge = uint64_t(1) << 62;
+  OverwriteBytes(file.Path(), offsetof(MatrixFileHeader, rows), &huge,
+                 sizeof(huge));
+  OverwriteBytes(file.Path(), offsetof(MatrixFileHeader, tile_rows), &huge,
+                 sizeof(huge));
+  EXPECT_THROW(MatrixFile<float>::Open(file.Path()), std::runtime_error);
+
+  // Data cut short: mapping it would fault on the missing pages.
+  store();
+  Truncate(file.Path(), MatrixFile<float>::Open(file.Path()).FileSize() - 1);
+  EXPECT_THROW(MatrixFile<float>::Open(file.Path()), std::runtime_error);
+  EXPECT_THROW(MappedMatrix<float>::Open(file.Path()), std::runtime_error);
+
+  // Header cut short.
+  Truncate(file.Path(), sizeof(MatrixFileHeader) / 2);
+  EXPECT_THROW(MatrixFile<float>::Open(file.Path()), std::runtime_error);
+  Truncate(file.Path(), 0);
+  EXPECT_THROW(MatrixFile<float>::Open(file.Path()), std::runtime_error);
+
+  EXPECT_THROW(MatrixFile<float>::Open(file.Path() + ".missing"),
+               std::system_error);
+}
+
+TEST(Sparse, SpMVMatchesDense) {
+  std::mt19937_64 gen(27);
+  const DynMatrix<int64_t> dense = RandomSparse(300, 200, 0.05, gen);
+  const DynMatrix<int64_t> x = RandomMatrix<int64_t>(200, 1, gen);
+  const DynMatrix<int64_t> expected = ReferenceMultiply(dense, x);
+  std::vector<int64_t> x_vector(x.Data(), x.Data() + x.Rows());
+  auto csr = CsrMatrix<int64_t>::FromDense(dense.View());
+  auto csc = CscMatrix<int64_t>::FromDense(dense.View());
+  std::vector<int64_t> y_csr = csr * x_vector;
+  std::vector<int64_t> y_csc = csc * x_vector;
+  ASSERT_EQ(y_csr.size(), 300u);
+  ASSERT_EQ(y_csc.size(), 300u);
+  for (size_t i = 0; i < 300; ++i) {
+    EXPECT_EQ(y_csr[i], expected(i, 0));
+    EXPECT_EQ(y_csc[i], expected(i, 0));
+  }
+  EXPECT_THROW(csr * std::vector<int64_t>(199), std::invalid_argument);
+  EXPECT_THROW(csc * std::vector<int64_t>(201), std::invalid_argument);
+}
+
+TEST(Sparse, SpMMMatchesDense) {
+  std::mt19937_64 gen(28);
+  const DynMatrix<int64_t> a = RandomSparse(150, 90, 0.1, gen);
+  const DynMatrix<int64_t> b = RandomMatrix<int64_t>(90, 33, gen);
+  auto csr = CsrMatrix<int64_t>::FromDense(a.View());
+  EXPECT_TRUE(csr * b == ReferenceMultiply(a, b));
+  DynMatrix<int64_t> wrong(89, 33);
+  EXPECT_THROW(csr * wrong, std::invalid_argument);
+}
+
+TEST(Sparse, SpGEMMMatchesDense) {
+  std::mt19937_64 gen(29);
+  const DynMatrix<int64_t> a = RandomSparse(120, 80, 0.08, gen);
+  const DynMatrix<int64_t> b = RandomSparse(80, 140, 0.08, gen);
+  auto product =
+      CsrMatrix<int64_t>::FromDense(a.View()) *
+      CsrMatrix<int64_t>::FromDense(b.View());
+  EXPECT_EQ(product.Rows(), 120u);
+  EXPECT_EQ(product.Columns(), 140u);
+  EXPECT_TRUE(product.ToDense() == ReferenceMultiply(a, b));
+  for (size_t i = 0; i < product.Rows(); ++i) {
+    EXPECT_TRUE(std::is_sorted(
+        product.ColIdx().begin() + product.RowPtr()[i],
+        product.ColIdx().begin() + product.RowPtr()[i + 1]));
+  }
+}
+
+TEST(Sparse, TripletsAndConversions) {
+  auto csr = CsrMatrix<int64_t>::FromTriplets(
+      3, 4, {{2, 1, 5}, {0, 3, 1}, {2, 1, 2}, {0, 0, 7}});
+  EXPECT_EQ(csr.NonZeros(), 3u);
+  EXPECT_EQ(csr(2, 1), 7);
+  EXPECT_EQ(csr(0, 0), 7);
+  EXPECT_EQ(csr(1, 2), 0);
+  CscMatrix<int64_t> csc(csr);
+  EXPECT_TRUE(csc.ToDense() == csr.ToDense());
+  EXPECT_TRUE(CsrMatrix<int64_t>(csc).ToDense() == csr.ToDense());
+  EXPECT_TRUE(csr.Transposed().ToDense() == csr.ToDense().Transposed());
+  EXPECT_THROW(CsrMatrix<int64_t>::FromTriplets(3, 4, {{3, 0, 1}}),
+               std::out_of_range);
+  EXPECT_THROW(CscMatrix<int64_t>::FromTriplets(3, 4, {{0, 4, 1}}),
+               std::out_of_range);
+}
+
+TEST(TypedKernels, FloatAndDoubleGemm) {
+  std::mt19937_64 gen(31);
+  const size_t shapes[][3] = {
+      {1, 1, 1}, {4, 16, 16}, {37, 29, 41}, {64, 130, 64}, {5, 300, 18}};
+  for (const auto& shape : shapes) {
+    ExpectGemmMatchesReference<float>(shape[0], shape[1], shape[2], gen);
+    ExpectGemmMatchesReference<double>(shape[0], shape[1], shape[2], gen);
+  }
+}
+
+TEST(TypedKernels, WideningProducts) {
+  std::mt19937_64 gen(32);
+  const size_t shapes[][3] = {{3, 5, 7}, {4, 2, 16}, {21, 35, 37},
+                              {64, 257, 48}};
+  for (const auto& shape : shapes) {
+    size_t n = shape[0];
+    size_t m = shape[1];
+    size_t k = shape[2];
+    DynMatrix<int8_t> a8 = RandomMatrix<int8_t>(n, m, gen, 127);
+    DynMatrix<int8_t> b8 = RandomMatrix<int8_t>(m, k, gen, 127);
+    DynMatrix<int32_t> c8(n, k);
+    matrix_kernels::GemmWiden(n, m, k, a8.Data(), m, b8.Data(), k, c8.Data(),
+                              k);
+    EXPECT_TRUE(c8 == (ReferenceMultiply<int32_t>(a8, b8)));
+
+    DynMatrix<int16_t> a16 = RandomMatrix<int16_t>(n, m, gen, 1000);
+    DynMatrix<int16_t> b16 = RandomMatrix<int16_t>(m, k, gen, 1000);
+    DynMatrix<int32_t> c16(n, k);
+    matrix_kernels::GemmWiden(n, m, k, a16.Data(), m, b16.Data(), k,
+                              c16.Data(), k);
+    EXPECT_TRUE(c16 == (ReferenceMultiply<int32_t>(a16, b16)));
+  }
+
+  auto a32 = RandomFixed<5, 6, int32_t>(gen, 2000000000);
+  auto b32 = RandomFixed<6, 7, int32_t>(gen, 2000000000);
+  Matrix<5, 7, int64_t> wide = MultiplyWide(a32, b32);
+  DynMatrix<int64_t> expected = ReferenceMultiply<int64_t>(
+      DynMatrix<int32_t>(a32.View()), DynMatrix<int32_t>(b32.View()));
+  EXPECT_TRUE(DynMatrix<int64_t>(wide.View()) == expected);
+
+  Matrix<3, 3, float> af(std::vector<std::vector<float>>{
+      {16777216.0f, 1, 0}, {0, 1, 0}, {0, 0, 1}});
+  Matrix<3, 3, float> bf(std::vector<std::vector<float>>{
+      {1, 0, 0}, {1, 1, 0}, {0, 0, 1}});
+  // 2^24 + 1 is not representable in float but is in double.
+  EXPECT_EQ(MultiplyWide(af, bf)(0, 0), 16777217.0);
+}
+
+TEST(TypedKernels, WideningProductsNeverWrap) {
+  const int16_t kMin = std::numeric_limits<int16_t>::min();
+  const int16_t kMax = std::numeric_limits<int16_t>::max();
+  // Large enough for the SIMD tiles: sums that cancel must come out exact
+  // even though m * max|a| * max|b| is far outside int32.
+  size_t n = 8;
+  size_t m = 64;
+  size_t k = 32;
+  DynMatrix<int16_t> a(n, m);
+  DynMatrix<int16_t> b(m, k);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t p = 0; p < m; ++p) {
+      a(i, p) = kMax;
+    }
+  }
+  for (size_t p = 0; p < m; ++p) {
+    for (size_t j = 0; j < k; ++j) {
+      b(p, j) = static_cast<int16_t>(p % 2 == 0 ? kMax : -kMax + int(j));
+    }
+  }
+  DynMatrix<int32_t> c(n, k);
+  matrix_kernels::GemmWiden(n, m, k, a.Data(), m, b.Data(), k, c.Data(), k);
+  EXPECT_TRUE(c == (ReferenceMultiply<int32_t>(a, b)));
+
+  // A single int16 pair already reaches 2^31.
+  DynMatrix<int16_t> pair_a(4, 2);
+  DynMatrix<int16_t> pair_b(2, 16);
+  for (size_t i = 0; i < 4; ++i) {
+    pair_a(i, 0) = kMin;
+    pair_a(i, 1) = kMin;
+  }
+  for (size_t j = 0; j < 16; ++j) {
+    pair_b(0, j) = kMin;
+    pair_b(1, j) = kMin;
+  }
+  DynMatrix<int32_t> pair_c(4, 16);
+  EXPECT_THROW(matrix_kernels::GemmWiden(4, 2, 16, pair_a.Data(), 2,
+                                         pair_b.Data(), 16, pair_c.Data(), 16),
+               std::overflow_error);
+  EXPECT_TRUE(pair_c == DynMatrix<int32_t>(4, 16));
+  pair_b(1, 0) = 1;
+  pair_b(1, 1) = -1;
+  pair_c(3, 15) = -5;
+  EXPECT_THROW(matrix_kernels::GemmWiden(4, 2, 16, pair_a.Data(), 2,
+                                         pair_b.Data(), 16, pair_c.Data(), 16),
+               std::overflow_error);
+  EXPECT_EQ(pair_c(3, 15), -5);
+  for (size_t j = 2; j < 16; ++j) {
+    pair_b(1, j) = 0;
+  }
+  pair_c(3, 15) = 0;
+  matrix_kernels::GemmWiden(4, 2, 16, pair_a.Data(), 2, pair_b.Data(), 16,
+                            pair_c.Data(), 16);
+  EXPECT_TRUE(pair_c == (ReferenceMultiply<int32_t>(pair_a, pair_b)));
+
+  // Existing C counts towards the bound too.
+  DynMatrix<int8_t> a8(4, 16, int8_t(1));
+  DynMatrix<int8_t> b8(16, 16, int8_t(1));
+  DynMatrix<int32_t> c8(4, 16, std::numeric_limits<int32_t>::max() - 16);
+  matrix_kernels::GemmWiden(4, 16, 16, a8.Data(), 16, b8.Data(), 16,
+                            c8.Data(), 16);
+  EXPECT_EQ(c8(3, 15), std::numeric_limits<int32_t>::max());
+  EXPECT_THROW(matrix_kernels::GemmWiden(4, 16, 16, a8.Data(), 16, b8.Data(),
+                                         16, c8.Data(), 16),
+               std::overflow_error);
+}
+
+TEST(TypedKernels, SaturatingProduct) {
+  std::mt19937_64 gen(33);
+  const int64_t kMax = std::numeric_limits<int64_t>::max();
+  std::uniform_int_distribution<int64_t> large(-(int64_t(1) << 62),
+                                               int64_t(1) << 62);
+  Matrix<4, 5, int64_t> a;
+  Matrix<5, 3, int64_t> b;
+  for (size_t i = 0; i < 4; ++i) {
+    for (size_t j = 0; j < 5; ++j) {
+      a(i, j) = j % 2 == 0 ? large(gen) : int64_t(j);
+    }
+  }
+  for (size_t i = 0; i < 5; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      b(i, j) = large(gen) >> (i * 15);
+    }
+  }
+  Matrix<4, 3, int64_t> product = MultiplySaturating(a, b);
+  for (size_t i = 0; i < 4; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      int64_t expected = 0;
+      for (size_t p = 0; p < 5; ++p) {
+        expected = Clamp(__int128(expected) +
+                         Clamp(__int128(a(i, p)) * b(p, j)));
+      }
+      EXPECT_EQ(product(i, j), expected) << i << "," << j;
+    }
+  }
+
+  Matrix<2, 2, int64_t> big(kMax);
+  EXPECT_EQ(MultiplySaturating(big, big), (Matrix<2, 2, int64_t>(kMax)));
+  auto small_a = RandomFixed<9, 7, int64_t>(gen);
+  auto small_b = RandomFixed<7, 8, int64_t>(gen);
+  EXPECT_EQ(MultiplySaturating(small_a, small_b), small_a * small_b);
+}
+
+TEST(Parallel, ThreadsFollowWork) {
+  namespace mk = matrix_kernels;
+  EXPECT_EQ(mk::ThreadsFor(0), 1u);
+  // A 64 x 64 GEMV is far too little work to start a thread for.
+  EXPECT_EQ(mk::ThreadsFor(64 * 64), 1u);
+  EXPECT_EQ(mk::ThreadsFor(2 * mk::kParallelGrain),
+            std::min<size_t>(2, mk::WorkerCount()));
+  EXPECT_EQ(mk::ThreadsFor(size_t(1) << 40), mk::WorkerCount());
+
+  // Every item is visited exactly once, however the range is split.
+  for (size_t item_work : {size_t(1), mk::kParallelGrain}) {
+    std::vector<int> visits(1000);
+    mk::ParallelFor(
+        visits.size(),
+        [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            ++visits[i];
+          }
+        },
+        item_work);
+    EXPECT_EQ(std::count(visits.begin(), visits.end(), 1), 1000);
+  }
+}
+
+TEST(Gemv, MatchesReference) {
+  std::mt19937_64 gen(34);
+  auto a = RandomFixed<37, 53, double>(gen);
+  DynMatrix<double> x = RandomMatrix<double>(53, 1, gen);
+  DynMatrix<double> expected =
+      ReferenceMultiply(DynMatrix<double>(a.View()), x);
+  std::array<double, 53> x_array;
+  std::copy(x.Data(), x.Data() + 53, x_array.begin());
+  std::vector<double> x_vector(x_array.begin(), x_array.end());
+  std::array<double, 37> y_array = a * x_array;
+  std::vector<double> y_vector = a * x_vector;
+  for (size_t i = 0; i < 37; ++i) {
+    EXPECT_EQ(y_array[i], expected(i, 0));
+    EXPECT_EQ(y_vector[i], expected(i, 0));
+  }
+  EXPECT_THROW(a * std::vector<double>(52), std::invalid_argument);
+
+  // Tall and wide shapes through the kernel, including ones past the
+  // threshold where rows are split across threads.
+  const size_t shapes[][2] = {{1, 1}, {3, 1000}, {1000, 3}, {700, 900}};
+  for (const auto& shape : shapes) {
+    DynMatrix<int64_t> m = RandomMatrix<int64_t>(shape[0], shape[1], gen);
+    DynMatrix<int64_t> v = RandomMatrix<int64_t>(shape[1], 1, gen);
+    std::vector<int64_t> y(shape[0]);
+    matrix_kernels::Gemv(shape[0], shape[1], m.Data(), m.Stride(), v.Data(),
+                         y.data());
+    DynMatrix<int64_t> reference = ReferenceMultiply(m, v);
+    EXPECT_TRUE(std::equal(y.begin(), y.end(), reference.Data()));
+  }
+}
+
+TEST(MultiplyBatch, MatchesSingleProducts) {
+  std::mt19937_64 gen(35);
+  // Not a multiple of kBatchLanes, so the last chunk is partial.
+  const size_t kBatch = 2 * matrix_kernels::kBatchLanes + 7;
+  std::vector<Matrix<3, 4, double>> first;
+  std::vector<Matrix<4, 5, double>> second;
+  for (size_t l = 0; l < kBatch; ++l) {
+    first.push_back(RandomFixed<3, 4, double>(gen));
+    second.push_back(RandomFixed<4, 5, double>(gen));
+  }
+  std::vector<Matrix<3, 5, double>> out = MultiplyBatch(first, second);
+  ASSERT_EQ(out.size(), kBatch);
+  for (size_t l = 0; l < kBatch; ++l) {
+    EXPECT_EQ(out[l], first[l] * second[l]) << l;
+  }
+
+  std::vector<Matrix<6, 6, int64_t>> square;
+  for (size_t l = 0; l < 5; ++l) {
+    square.push_back(RandomFixed<6, 6, int64_t>(gen));
+  }
+  std::vector<Matrix<6, 6, int64_t>> squared = MultiplyBatch(square, square);
+  for (size_t l = 0; l < 5; ++l) {
+    EXPECT_EQ(squared[l], square[l] * square[l]);
+  }
+  second.pop_back();
+  EXPECT_THROW(MultiplyBatch(first, second), std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
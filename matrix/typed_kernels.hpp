@@ -0,0 +1,472 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATRIX_KERNELS_X86 1
+#endif
+
+#include "kernels.hpp"
+
+// Kernels chosen by element type. The SIMD versions are compiled with
+// per-function target attributes and picked at run time from the CPU
+// feature bits, so a generic -O2 build still uses AVX2/FMA/VNNI when the
+// machine has them.
+
+namespace matrix_kernels {
+
+inline bool HasAvx2() {
+#ifdef MATRIX_KERNELS_X86
+  static const bool kSupported = __builtin_cpu_supports("avx2");
+  return kSupported;
+#else
+  return false;
+#endif
+}
+
+inline bool HasAvx2Fma() {
+#ifdef MATRIX_KERNELS_X86
+  static const bool kSupported =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return kSupported;
+#else
+  return false;
+#endif
+}
+
+inline bool HasAvxVnni() {
+#ifdef MATRIX_KERNELS_X86
+  static const bool kSupported =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avxvnni");
+  return kSupported;
+#else
+  return false;
+#endif
+}
+
+// Result type of a widening product: narrow integers accumulate in int32,
+// int32 in int64 and float in double.
+template <typename T>
+struct Widened;
+
+template <>
+struct Widened<int8_t> {
+  using Type = int32_t;
+};
+template <>
+struct Widened<int16_t> {
+  using Type = int32_t;
+};
+template <>
+struct Widened<int32_t> {
+  using Type = int64_t;
+};
+template <>
+struct Widened<float> {
+  using Type = double;
+};
+
+#ifdef MATRIX_KERNELS_X86
+namespace simd {
+
+struct FloatLanes {
+  using Scalar = float;
+  using Reg = __m256;
+  static const size_t kWidth = 8;
+
+  __attribute__((target("avx2,fma"))) static Reg Load(const float* ptr) {
+    return _mm256_loadu_ps(ptr);
+  }
+  __attribute__((target("avx2,fma"))) static void Store(float* ptr, Reg reg) {
+    _mm256_storeu_ps(ptr, reg);
+  }
+  __attribute__((target("avx2,fma"))) static Reg Broadcast(float value) {
+    return _mm256_set1_ps(value);
+  }
+  __attribute__((target("avx2,fma"))) static Reg Fma(Reg lhs, Reg rhs,
+                                                      Reg acc) {
+    return _mm256_fmadd_ps(lhs, rhs, acc);
+  }
+};
+
+struct DoubleLanes {
+  using Scalar = double;
+  using Reg = __m256d;
+  static const size_t kWidth = 4;
+
+  __attribute__((target("avx2,fma"))) static Reg Load(const double* ptr) {
+    return _mm256_loadu_pd(ptr);
+  }
+  __attribute__((target("avx2,fma"))) static void Store(double* ptr, Reg reg) {
+    _mm256_storeu_pd(ptr, reg);
+  }
+  __attribute__((target("avx2,fma"))) static Reg Broadcast(double value) {
+    return _mm256_set1_pd(value);
+  }
+  __attribute__((target("avx2,fma"))) static Reg Fma(Reg lhs, Reg rhs,
+                                                      Reg acc) {
+    return _mm256_fmadd_pd(lhs, rhs, acc);
+  }
+};
+
+// Register-blocked FMA GEMM: a 4 x (2 * kWidth) tile of C stays in eight
+// accumulators for a whole kGemmBlockK slice of the inner dimension, so each
+// loaded B vector feeds four FMAs. Edges fall back to the generic loop.
+template <typename Lanes>
+__attribute__((target("avx2,fma"))) void GemmFma(
+    size_t n, size_t m, size_t k, const typename Lanes::Scalar* a, size_t lda,
+    const typename Lanes::Scalar* b, size_t ldb, typename Lanes::Scalar* c,
+    size_t ldc, bool subtract) {
+  using Scalar = typename Lanes::Scalar;
+  using Reg = typename Lanes::Reg;
+  const size_t kRows = 4;
+  const size_t kColumns = 2 * Lanes::kWidth;
+  size_t n_vec = n - n % kRows;
+  size_t k_vec = k - k % kColumns;
+  for (size_t kk = 0; kk < m; kk += kGemmBlockK) {
+    size_t k_end = std::min(kk + kGemmBlockK, m);
+    for (size_t jj = 0; jj < k_vec; jj += kGemmBlockCols) {
+      size_t j_end = std::min(jj + kGemmBlockCols, k_vec);
+      for (size_t iii = 0; iii < n_vec; iii += kRows) {
+        for (size_t jjj = jj; jjj < j_end; jjj += kColumns) {
+          Reg acc[kRows][2];
+          for (size_t rrr = 0; rrr < kRows; ++rrr) {
+            acc[rrr][0] = Lanes::Load(c + (iii + rrr) * ldc + jjj);
+            acc[rrr][1] =
+                Lanes::Load(c + (iii + rrr) * ldc + jjj + Lanes::kWidth);
+          }
+          for (size_t ppp = kk; ppp < k_end; ++ppp) {
+            Reg b0 = Lanes::Load(b + ppp * ldb + jjj);
+            Reg b1 = Lanes::Load(b + ppp * ldb + jjj + Lanes::kWidth);
+            for (size_t rrr = 0; rrr < kRows; ++rrr) {
+              Scalar value = a[(iii + rrr) * lda + ppp];
+              Reg a_reg = Lanes::Broadcast(subtract ? -value : value);
+              acc[rrr][0] = Lanes::Fma(a_reg, b0, acc[rrr][0]);
+              acc[rrr][1] = Lanes::Fma(a_reg, b1, acc[rrr][1]);
+            }
+          }
+          for (size_t rrr = 0; rrr < kRows; ++rrr) {
+            Lanes::Store(c + (iii + rrr) * ldc + jjj, acc[rrr][0]);
+            Lanes::Store(c + (iii + rrr) * ldc + jjj + Lanes::kWidth,
+                         acc[rrr][1]);
+          }
+        }
+      }
+    }
+    if (n_vec < n) {
+      GemmUpdateGeneric(n - n_vec, k_end - kk, k_vec, a + n_vec * lda + kk,
+                        lda, b + kk * ldb, ldb, c + n_vec * ldc, ldc,
+                        subtract);
+    }
+    if (k_vec < k) {
+      GemmUpdateGeneric(n, k_end - kk, k - k_vec, a + kk, lda,
+                        b + kk * ldb + k_vec, ldb, c + k_vec, ldc, subtract);
+    }
+  }
+}
+
+// c[4 x 16] += sum over `depth` pairs q of a_pairs(r, q) . packed(q, :),
+// where a pair packs two int16 values into an int32 and `packed` holds
+// matching int16 pairs of B. vpmaddwd multiplies the pairs and adds them
+// into eight int32 lanes. (pmaddubsw is unsigned x signed and saturates to
+// int16, so it does not fit a signed int8 x int8 product.)
+__attribute__((target("avx2"))) inline void PairTileAvx2(
+    const int32_t* a_pairs, size_t a_stride, const int16_t* packed,
+    size_t packed_stride, size_t depth, int32_t* c, size_t ldc) {
+  __m256i acc[4][2];
+  for (size_t rrr = 0; rrr < 4; ++rrr) {
+    acc[rrr][0] = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(c + rrr * ldc));
+    acc[rrr][1] = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(c + rrr * ldc + 8));
+  }
+  for (size_t qqq = 0; qqq < depth; ++qqq) {
+    const int16_t* row = packed + qqq * packed_stride;
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+    __m256i b1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 16));
+    for (size_t rrr = 0; rrr < 4; ++rrr) {
+      __m256i a_reg = _mm256_set1_epi32(a_pairs[rrr * a_stride + qqq]);
+      acc[rrr][0] = _mm256_add_epi32(acc[rrr][0], _mm256_madd_epi16(b0, a_reg));
+      acc[rrr][1] = _mm256_add_epi32(acc[rrr][1], _mm256_madd_epi16(b1, a_reg));
+    }
+  }
+  for (size_t rrr = 0; rrr < 4; ++rrr) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + rrr * ldc),
+                        acc[rrr][0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + rrr * ldc + 8),
+                        acc[rrr][1]);
+  }
+}
+
+// Same tile with AVX-VNNI: vpdpwssd fuses the multiply, pair add and
+// accumulate into one instruction.
+__attribute__((target("avx2,avxvnni"))) inline void PairTileVnni(
+    const int32_t* a_pairs, size_t a_stride, const int16_t* packed,
+    size_t packed_stride, size_t depth, int32_t* c, size_t ldc) {
+  __m256i acc[4][2];
+  for (size_t rrr = 0; rrr < 4; ++rrr) {
+    acc[rrr][0] = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(c + rrr * ldc));
+    acc[rrr][1] = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(c + rrr * ldc + 8));
+  }
+  for (size_t qqq = 0; qqq < depth; ++qqq) {
+    const int16_t* row = packed + qqq * packed_stride;
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row));
+    __m256i b1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + 16));
+    for (size_t rrr = 0; rrr < 4; ++rrr) {
+      __m256i a_reg = _mm256_set1_epi32(a_pairs[rrr * a_stride + qqq]);
+      acc[rrr][0] = _mm256_dpwssd_avx_epi32(acc[rrr][0], b0, a_reg);
+      acc[rrr][1] = _mm256_dpwssd_avx_epi32(acc[rrr][1], b1, a_reg);
+    }
+  }
+  for (size_t rrr = 0; rrr < 4; ++rrr) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + rrr * ldc),
+                        acc[rrr][0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + rrr * ldc + 8),
+                        acc[rrr][1]);
+  }
+}
+
+}  // namespace simd
+#endif
+
+template <>
+inline void GemmUpdate<float>(size_t n, size_t m, size_t k, const float* a,
+                              size_t lda, const float* b, size_t ldb, float* c,
+                              size_t ldc, bool subtract) {
+#ifdef MATRIX_KERNELS_X86
+  if (HasAvx2Fma()) {
+    simd::GemmFma<simd::FloatLanes>(n, m, k, a, lda, b, ldb, c, ldc, subtract);
+    return;
+  }
+#endif
+  GemmUpdateGeneric(n, m, k, a, lda, b, ldb, c, ldc, subtract);
+}
+
+template <>
+inline void GemmUpdate<double>(size_t n, size_t m, size_t k, const double* a,
+                               size_t lda, const double* b, size_t ldb,
+                               double* c, size_t ldc, bool subtract) {
+#ifdef MATRIX_KERNELS_X86
+  if (HasAvx2Fma()) {
+    simd::GemmFma<simd::DoubleLanes>(n, m, k, a, lda, b, ldb, c, ldc,
+                                     subtract);
+    return;
+  }
+#endif
+  GemmUpdateGeneric(n, m, k, a, lda, b, ldb, c, ldc, subtract);
+}
+
+// C[n x k] += A * B with inputs of type In and accumulation in Out.
+template <typename In, typename Out>
+void GemmWidenGeneric(size_t n, size_t m, size_t k, const In* a, size_t lda,
+                      const In* b, size_t ldb, Out* c, size_t ldc) {
+  for (size_t iii = 0; iii < n; ++iii) {
+    Out* c_row = c + iii * ldc;
+    for (size_t ppp = 0; ppp < m; ++ppp) {
+      const Out a_elem = static_cast<Out>(a[iii * lda + ppp]);
+      const In* b_row = b + ppp * ldb;
+      for (size_t jjj = 0; jjj < k; ++jjj) {
+        c_row[jjj] += a_elem * static_cast<Out>(b_row[jjj]);
+      }
+    }
+  }
+}
+
+template <typename T>
+uint64_t MaxMagnitude(size_t rows, size_t cols, const T* data, size_t ld) {
+  uint64_t result = 0;
+  for (size_t iii = 0; iii < rows; ++iii) {
+    for (size_t jjj = 0; jjj < cols; ++jjj) {
+      int64_t value = static_cast<int64_t>(data[iii * ld + jjj]);
+      uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value)
+                                     : static_cast<uint64_t>(value);
+      result = std::max(result, magnitude);
+    }
+  }
+  return result;
+}
+
+// C[n x k] += A * B accumulated in int64, then narrowed to int32. Throws
+// std::overflow_error, leaving C unchanged, if any result does not fit.
+template <typename In>
+void GemmWidenChecked(size_t n, size_t m, size_t k, const In* a, size_t lda,
+                      const In* b, size_t ldb, int32_t* c, size_t ldc) {
+  AlignedVector<int64_t> wide(n * k);
+  for (size_t iii = 0; iii < n; ++iii) {
+    std::copy(c + iii * ldc, c + iii * ldc + k, wide.data() + iii * k);
+  }
+  GemmWidenGeneric(n, m, k, a, lda, b, ldb, wide.data(), k);
+  for (int64_t value : wide) {
+    if (value < std::numeric_limits<int32_t>::min() ||
+        value > std::numeric_limits<int32_t>::max()) {
+      throw std::overflow_error("GemmWiden: result overflows int32");
+    }
+  }
+  for (size_t iii = 0; iii < n; ++iii) {
+    std::copy(wide.data() + iii * k, wide.data() + (iii + 1) * k,
+              c + iii * ldc);
+  }
+}
+
+// int8 x int8 or int16 x int16 into int32. A is packed into int32 pairs
+// and B into interleaved int16 row pairs once, then 4 x 16 tiles run on
+// VNNI or AVX2. The int32 accumulators (and, for int16, the pair sum
+// (-32768) * (-32768) * 2) wrap silently, so these paths only run when
+// |C| + m * max|A| * max|B| fits in int32; otherwise the product is
+// accumulated in int64 and narrowed with a check.
+template <typename In>
+void GemmWidenPairs(size_t n, size_t m, size_t k, const In* a, size_t lda,
+                    const In* b, size_t ldb, int32_t* c, size_t ldc) {
+  uint64_t bound;
+  if (__builtin_mul_overflow(MaxMagnitude(n, m, a, lda),
+                             MaxMagnitude(m, k, b, ldb), &bound) ||
+      __builtin_mul_overflow(bound, static_cast<uint64_t>(m), &bound) ||
+      __builtin_add_overflow(bound, MaxMagnitude(n, k, c, ldc), &bound) ||
+      bound > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) {
+    GemmWidenChecked(n, m, k, a, lda, b, ldb, c, ldc);
+    return;
+  }
+#ifdef MATRIX_KERNELS_X86
+  using TileFn = void (*)(const int32_t*, size_t, const int16_t*, size_t,
+                          size_t, int32_t*, size_t);
+  TileFn tile = HasAvxVnni() ? simd::PairTileVnni
+                : HasAvx2()  ? simd::PairTileAvx2
+                             : nullptr;
+  size_t n_vec = n - n % 4;
+  size_t k_vec = k - k % 16;
+  if (tile != nullptr && n_vec > 0 && k_vec > 0) {
+    size_t pairs = (m + 1) / 2;
+    AlignedVector<int32_t> a_pairs(n_vec * pairs);
+    for (size_t iii = 0; iii < n_vec; ++iii) {
+      for (size_t qqq = 0; qqq < pairs; ++qqq) {
+        uint16_t low = static_cast<uint16_t>(a[iii * lda + 2 * qqq]);
+        uint16_t high = 2 * qqq + 1 < m
+                            ? static_cast<uint16_t>(a[iii * lda + 2 * qqq + 1])
+                            : 0;
+        a_pairs[iii * pairs + qqq] =
+            static_cast<int32_t>(low | (static_cast<uint32_t>(high) << 16));
+      }
+    }
+    size_t packed_stride = 2 * k_vec;
+    AlignedVector<int16_t> packed(pairs * packed_stride);
+    for (size_t ppp = 0; ppp < m; ++ppp) {
+      int16_t* row = packed.data() + (ppp / 2) * packed_stride + ppp % 2;
+      for (size_t jjj = 0; jjj < k_vec; ++jjj) {
+        row[2 * jjj] = b[ppp * ldb + jjj];
+      }
+    }
+    for (size_t q0 = 0; q0 < pairs; q0 += kGemmBlockK) {
+      size_t q1 = std::min(q0 + kGemmBlockK, pairs);
+      for (size_t iii = 0; iii < n_vec; iii += 4) {
+        for (size_t jjj = 0; jjj < k_vec; jjj += 16) {
+          tile(a_pairs.data() + iii * pairs + q0, pairs,
+               packed.data() + q0 * packed_stride + 2 * jjj, packed_stride,
+               q1 - q0, c + iii * ldc + jjj, ldc);
+        }
+      }
+    }
+    if (n_vec < n) {
+      GemmWidenGeneric(n - n_vec, m, k_vec, a + n_vec * lda, lda, b, ldb,
+                       c + n_vec * ldc, ldc);
+    }
+    if (k_vec < k) {
+      GemmWidenGeneric(n, m, k - k_vec, a, lda, b + k_vec, ldb, c + k_vec,
+                       ldc);
+    }
+    return;
+  }
+#endif
+  GemmWidenGeneric(n, m, k, a, lda, b, ldb, c, ldc);
+}
+
+inline void GemmWiden(size_t n, size_t m, size_t k, const int8_t* a,
+                      size_t lda, const int8_t* b, size_t ldb, int32_t* c,
+                      size_t ldc) {
+  GemmWidenPairs(n, m, k, a, lda, b, ldb, c, ldc);
+}
+
+inline void GemmWiden(size_t n, size_t m, size_t k, const int16_t* a,
+                      size_t lda, const int16_t* b, size_t ldb, int32_t* c,
+                      size_t ldc) {
+  GemmWidenPairs(n, m, k, a, lda, b, ldb, c, ldc);
+}
+
+inline void GemmWiden(size_t n, size_t m, size_t k, const int32_t* a,
+                      size_t lda, const int32_t* b, size_t ldb, int64_t* c,
+                      size_t ldc) {
+  GemmWidenGeneric(n, m, k, a, lda, b, ldb, c, ldc);
+}
+
+// float inputs with double accumulation: widen once (O(n^2)), then run the
+// double FMA kernel (O(n^3)).
+inline void GemmWiden(size_t n, size_t m, size_t k, const float* a,
+                      size_t lda, const float* b, size_t ldb, double* c,
+                      size_t ldc) {
+  AlignedVector<double> a_wide(n * m);
+  AlignedVector<double> b_wide(m * k);
+  for (size_t iii = 0; iii < n; ++iii) {
+    std::copy(a + iii * lda, a + iii * lda + m, a_wide.data() + iii * m);
+  }
+  for (size_t iii = 0; iii < m; ++iii) {
+    std::copy(b + iii * ldb, b + iii * ldb + k, b_wide.data() + iii * k);
+  }
+  Gemm(n, m, k, a_wide.data(), m, b_wide.data(), k, c, ldc);
+}
+
+inline int64_t SaturatingAdd(int64_t lhs, int64_t rhs) {
+  int64_t result;
+  if (__builtin_add_overflow(lhs, rhs, &result)) {
+    return rhs > 0 ? std::numeric_limits<int64_t>::max()
+                   : std::numeric_limits<int64_t>::min();
+  }
+  return result;
+}
+
+inline int64_t SaturatingMul(int64_t lhs, int64_t rhs) {
+  int64_t result;
+  if (__builtin_mul_overflow(lhs, rhs, &result)) {
+    return (lhs < 0) != (rhs < 0) ? std::numeric_limits<int64_t>::min()
+                                  : std::numeric_limits<int64_t>::max();
+  }
+  return result;
+}
+
+// C[n x k] += A * B for int64 where every product and partial sum clamps to
+// [INT64_MIN, INT64_MAX] instead of wrapping; sums run in increasing p.
+// When the magnitudes prove that nothing can overflow, the ordinary blocked
+// kernel is used instead.
+inline void GemmSaturating(size_t n, size_t m, size_t k, const int64_t* a,
+                           size_t lda, const int64_t* b, size_t ldb,
+                           int64_t* c, size_t ldc) {
+  uint64_t bound;
+  uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+  if (!__builtin_mul_overflow(MaxMagnitude(n, m, a, lda),
+                              MaxMagnitude(m, k, b, ldb), &bound) &&
+      !__builtin_mul_overflow(bound, static_cast<uint64_t>(m), &bound) &&
+      !__builtin_add_overflow(bound, MaxMagnitude(n, k, c, ldc), &bound) &&
+      bound <= limit) {
+    Gemm(n, m, k, a, lda, b, ldb, c, ldc);
+    return;
+  }
+  for (size_t iii = 0; iii < n; ++iii) {
+    int64_t* c_row = c + iii * ldc;
+    for (size_t ppp = 0; ppp < m; ++ppp) {
+      const int64_t a_elem = a[iii * lda + ppp];
+      const int64_t* b_row = b + ppp * ldb;
+      for (size_t jjj = 0; jjj < k; ++jjj) {
+        c_row[jjj] =
+            SaturatingAdd(c_row[jjj], SaturatingMul(a_elem, b_row[jjj]));
+      }
+    }
+  }
+}
+
+}  // namespace matrix_kernels
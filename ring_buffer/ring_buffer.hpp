@@ -1,35 +1,372 @@
-#include <iostream>
-
 #pragma once
 
+#include <atomic>
 #include <cstddef>
-#include <vector>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Capacity argument of RingBuffer and SpscRingBuffer meaning "given to the
+// constructor"; the slots are then allocated once, on the heap.
+const size_t kDynamicCapacity = static_cast<size_t>(-1);
+
+namespace ring_buffer_detail {
+
+// Smallest power of two that is >= value (1 for 0). Throws
+// std::length_error when that does not fit in size_t.
+constexpr size_t RoundUpToPowerOfTwo(size_t value) {
+  if (value > (static_cast<size_t>(-1) >> 1) + 1) {
+    throw std::length_error("RingBuffer: capacity too large");
+  }
+  size_t power = 1;
+  while (power < value) {
+    power <<= 1;
+  }
+  return power;
+}
+
+// Head and tail live on separate lines so that the producer and the
+// consumer do not invalidate each other's cache line on every operation.
+const size_t kCacheLine = 64;
+
+// Uninitialized room for one T; elements are constructed in place when
+// pushed and destroyed when popped.
+template <typename T>
+struct alignas(T) Slot {
+  unsigned char bytes[sizeof(T)];
+
+  T* Get() { return std::launder(reinterpret_cast<T*>(bytes)); }
+};
+
+// The array of a ring of at least kCapacity (and kMinCells) cells, a power
+// of two: inline when kCapacity is a compile-time constant, on the heap
+// otherwise. Limit() is the capacity itself. Cell is Slot<T>, or a slot
+// with a sequence number for MpmcRingBuffer.
+template <typename Cell, size_t kCapacity, size_t kMinCells = 1>
+class Storage {
+ private:
+  static const size_t kCells =
+      RoundUpToPowerOfTwo(kCapacity < kMinCells ? kMinCells : kCapacity);
+
+  Cell cells_[kCells];
+
+ public:
+  static size_t Limit() { return kCapacity; }
+  static size_t Cells() { return kCells; }
+  Cell& At(size_t position) { return cells_[position & (kCells - 1)]; }
+};
+
+template <typename Cell, size_t kMinCells>
+class Storage<Cell, kDynamicCapacity, kMinCells> {
+ private:
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_;
+  size_t capacity_;
+
+ public:
+  explicit Storage(size_t capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity < kMinCells ? kMinCells
+                                                       : capacity) -
+              1),
+        capacity_(capacity) {
+    cells_.reset(new Cell[mask_ + 1]);
+  }
+  size_t Limit() const { return capacity_; }
+  size_t Cells() const { return mask_ + 1; }
+  Cell& At(size_t position) { return cells_[position & mask_]; }
+};
 
+}  // namespace ring_buffer_detail
+
+// Bounded FIFO queue over a preallocated circular array. head_ and tail_
+// count pops and pushes from the start and only ever grow; the slot of a
+// position is position & mask, which is why the array length is a power
+// of two (at least the capacity). Every operation is O(1); elements are
+// constructed in place by TryEmplace and moved out by TryPop, and nothing
+// is allocated after construction (nothing at all for a fixed kCapacity,
+// whose slots are stored inline).
+template <typename T, size_t kCapacity = kDynamicCapacity>
 class RingBuffer {
  private:
-  std::vector<int> queue_;
-  size_t max_count_ = 0;
+  ring_buffer_detail::Storage<ring_buffer_detail::Slot<T>, kCapacity> storage_;
+  size_t head_ = 0;
+  size_t tail_ = 0;
 
  public:
-  size_t count = 0;
-  explicit RingBuffer(size_t capacity) : max_count_(capacity) {}
-  size_t Size() const { return count; }
-  bool Empty() const { return count == 0; }
-  bool TryPush(int element) {
-    if (count == max_count_) {
+  RingBuffer()
+    requires(kCapacity != kDynamicCapacity)
+  = default;
+  explicit RingBuffer(size_t capacity)
+    requires(kCapacity == kDynamicCapacity)
+      : storage_(capacity) {}
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+  ~RingBuffer() {
+    for (; head_ != tail_; ++head_) {
+      storage_.At(head_).Get()->~T();
+    }
+  }
+
+  size_t Size() const { return tail_ - head_; }
+  bool Empty() const { return tail_ == head_; }
+  size_t Capacity() const { return storage_.Limit(); }
+
+  // Constructs T(args...) at the back; false, constructing nothing, when
+  // the queue is full.
+  template <typename... Args>
+  bool TryEmplace(Args&&... args) {
+    if (Size() == storage_.Limit()) {
       return false;
     }
-    queue_.push_back(element);
-    count++;
+    new (storage_.At(tail_).Get()) T(std::forward<Args>(args)...);
+    ++tail_;
     return true;
   }
-  bool TryPop(int* element) {
-    if (!Empty()) {
-      *element = *queue_.begin();
-      queue_.erase(queue_.begin());
-      count--;
-      return true;
+  bool TryPush(const T& element) { return TryEmplace(element); }
+  bool TryPush(T&& element) { return TryEmplace(std::move(element)); }
+
+  // Moves the front element into `element` and destroys it in the queue.
+  bool TryPop(T& element) {
+    if (Empty()) {
+      return false;
+    }
+    T* front = storage_.At(head_).Get();
+    element = std::move(*front);
+    front->~T();
+    ++head_;
+    return true;
+  }
+  bool TryPop(T* element) { return TryPop(*element); }
+};
+
+// Lock-free RingBuffer for exactly one producer thread (TryEmplace and
+// TryPush) and one consumer thread (TryPop). The producer publishes a slot
+// by storing tail_ with release order after constructing the element; the
+// consumer frees a slot by storing head_ with release order after moving
+// it out; each side loads the other's index with acquire order. Each side
+// also keeps a cached copy of the other's index and reloads it only when
+// the queue looks full (or empty), so in steady state neither touches the
+// other's cache line. The class is cache-line aligned, so its size is
+// padded to whole lines too.
+template <typename T, size_t kCapacity = kDynamicCapacity>
+class SpscRingBuffer {
+ private:
+  ring_buffer_detail::Storage<ring_buffer_detail::Slot<T>, kCapacity> storage_;
+
+  // Written by the consumer.
+  alignas(ring_buffer_detail::kCacheLine) std::atomic<size_t> head_{0};
+  size_t cached_tail_ = 0;
+  // Written by the producer.
+  alignas(ring_buffer_detail::kCacheLine) std::atomic<size_t> tail_{0};
+  size_t cached_head_ = 0;
+
+ public:
+  SpscRingBuffer()
+    requires(kCapacity != kDynamicCapacity)
+  = default;
+  explicit SpscRingBuffer(size_t capacity)
+    requires(kCapacity == kDynamicCapacity)
+      : storage_(capacity) {}
+  SpscRingBuffer(const SpscRingBuffer&) = delete;
+  SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+  ~SpscRingBuffer() {
+    size_t tail = tail_.load(std::memory_order_acquire);
+    for (size_t head = head_.load(std::memory_order_relaxed); head != tail;
+         ++head) {
+      storage_.At(head).Get()->~T();
     }
-    return false;
   }
+
+  // Exact only while neither side is running; a snapshot otherwise.
+  size_t Size() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+  bool Empty() const { return Size() == 0; }
+  size_t Capacity() const { return storage_.Limit(); }
+
+  // Producer only.
+  template <typename... Args>
+  bool TryEmplace(Args&&... args) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == storage_.Limit()) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == storage_.Limit()) {
+        return false;
+      }
+    }
+    new (storage_.At(tail).Get()) T(std::forward<Args>(args)...);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+  bool TryPush(const T& element) { return TryEmplace(element); }
+  bool TryPush(T&& element) { return TryEmplace(std::move(element)); }
+
+  // Consumer only.
+  bool TryPop(T& element) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    T* front = storage_.At(head).Get();
+    element = std::move(*front);
+    front->~T();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  bool TryPop(T* element) { return TryPop(*element); }
+};
+
+// Lock-free bounded queue for any number of producer and consumer threads
+// (D. Vyukov's bounded MPMC queue). Every cell carries a sequence number:
+// cell i starts at i, becomes pos + 1 once the element pushed at position
+// pos is published, and pos + Cells() once it has been popped, which makes
+// the cell free for position pos + Cells(). A producer claims the next
+// position with one CAS on enqueue_ when the cell's sequence says it is
+// free, constructs the element, then publishes it with a release store of
+// the sequence; consumers mirror this on dequeue_. Producers contend only
+// with producers and consumers only with consumers, each on its own cache
+// line, and a full or empty queue is detected without touching the other
+// side's counter.
+//
+// The array is kCapacity (or the constructor argument) rounded up to a
+// power of two, and at least 2 cells, as the sequence arithmetic needs
+// every cell of the array. Capacity() is the requested bound itself: when
+// it is smaller than the array, producers also check their distance to
+// dequeue_ before claiming a position.
+//
+// A claimed position must be published, or consumers would wait on it
+// forever, so nothing may throw between the claim and the release store:
+// T must be nothrow move constructible and assignable, and TryEmplace
+// builds a T that may throw before claiming and moves it in afterwards.
+template <typename T, size_t kCapacity = kDynamicCapacity>
+  requires(std::is_nothrow_move_constructible_v<T> &&
+           std::is_nothrow_move_assignable_v<T>)
+class MpmcRingBuffer {
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    ring_buffer_detail::Slot<T> slot;
+  };
+
+  // With a single cell "published at pos" and "free for pos + 1" would be
+  // the same sequence number, so there are always at least two.
+  ring_buffer_detail::Storage<Cell, kCapacity, 2> storage_;
+
+  alignas(ring_buffer_detail::kCacheLine) std::atomic<size_t> enqueue_{0};
+  alignas(ring_buffer_detail::kCacheLine) std::atomic<size_t> dequeue_{0};
+
+  void InitSequences() {
+    for (size_t cell = 0; cell < storage_.Cells(); ++cell) {
+      storage_.At(cell).sequence.store(cell, std::memory_order_relaxed);
+    }
+  }
+
+  // Claims a position and constructs T(args...) there; nothing it calls
+  // may throw.
+  template <typename... Args>
+  bool Emplace(Args&&... args) noexcept {
+    size_t pos = enqueue_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &storage_.At(pos);
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      auto lag = static_cast<std::ptrdiff_t>(sequence - pos);
+      if (lag == 0) {
+        if (storage_.Limit() < storage_.Cells() &&
+            static_cast<std::ptrdiff_t>(
+                pos - dequeue_.load(std::memory_order_acquire)) >=
+                static_cast<std::ptrdiff_t>(storage_.Limit())) {
+          // The cell is free, but Capacity() elements are already queued.
+          return false;
+        }
+        if (enqueue_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lag < 0) {
+        // The cell still holds the element pushed Cells() positions ago.
+        return false;
+      } else {
+        pos = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+    new (cell->slot.Get()) T(std::forward<Args>(args)...);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+ public:
+  MpmcRingBuffer()
+    requires(kCapacity != kDynamicCapacity)
+  {
+    InitSequences();
+  }
+  explicit MpmcRingBuffer(size_t capacity)
+    requires(kCapacity == kDynamicCapacity)
+      : storage_(capacity) {
+    InitSequences();
+  }
+  MpmcRingBuffer(const MpmcRingBuffer&) = delete;
+  MpmcRingBuffer& operator=(const MpmcRingBuffer&) = delete;
+  ~MpmcRingBuffer() {
+    size_t tail = enqueue_.load(std::memory_order_acquire);
+    for (size_t head = dequeue_.load(std::memory_order_acquire); head != tail;
+         ++head) {
+      storage_.At(head).slot.Get()->~T();
+    }
+  }
+
+  // A snapshot while other threads are running.
+  size_t Size() const {
+    size_t head = dequeue_.load(std::memory_order_acquire);
+    return enqueue_.load(std::memory_order_acquire) - head;
+  }
+  bool Empty() const { return Size() == 0; }
+  size_t Capacity() const { return storage_.Limit(); }
+
+  // When T(args...) may throw, the element is built (and may throw) before
+  // a position is claimed, and is discarded if the queue is full.
+  template <typename... Args>
+  bool TryEmplace(Args&&... args) {
+    if constexpr (std::is_nothrow_constructible_v<T, Args&&...>) {
+      return Emplace(std::forward<Args>(args)...);
+    } else {
+      return Emplace(T(std::forward<Args>(args)...));
+    }
+  }
+  bool TryPush(const T& element) { return TryEmplace(element); }
+  bool TryPush(T&& element) { return TryEmplace(std::move(element)); }
+
+  bool TryPop(T& element) {
+    size_t pos = dequeue_.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &storage_.At(pos);
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      auto lag = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+      if (lag == 0) {
+        if (dequeue_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (lag < 0) {
+        // Nothing has been published at pos yet.
+        return false;
+      } else {
+        pos = dequeue_.load(std::memory_order_relaxed);
+      }
+    }
+    T* front = cell->slot.Get();
+    element = std::move(*front);
+    front->~T();
+    cell->sequence.store(pos + storage_.Cells(), std::memory_order_release);
+    return true;
+  }
+  bool TryPop(T* element) { return TryPop(*element); }
 };
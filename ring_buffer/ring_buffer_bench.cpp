@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.hpp"
+
+// Throughput of the shared queues under contention: every combination of
+// producer and consumer thread counts pushes the same number of items
+// through MpmcRingBuffer, through a RingBuffer behind a std::mutex (the
+// usual way to share the single-threaded queue), and, for one producer
+// and one consumer, through SpscRingBuffer. Every run checks that each
+// item arrived exactly once.
+//
+//   ring_buffer_bench            full sweep
+//   ring_buffer_bench --quick    small sweep, exits non-zero on a lost item
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t kQueueCapacity = 1024;
+
+// TryPush/TryPop for RingBuffer, serialized by one mutex.
+class LockedRingBuffer {
+ private:
+  std::mutex mutex_;
+  RingBuffer<uint64_t> queue_;
+
+ public:
+  explicit LockedRingBuffer(size_t capacity) : queue_(capacity) {}
+  bool TryPush(uint64_t element) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.TryPush(element);
+  }
+  bool TryPop(uint64_t& element) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.TryPop(element);
+  }
+};
+
+struct Result {
+  double ops_per_second;
+  bool ok;
+};
+
+// Producers push the values 1..items between them; consumers pop until
+// all have been taken. Failed attempts yield, so that oversubscribed runs
+// (more threads than cores) still make progress.
+template <typename Queue>
+Result Run(Queue& queue, size_t producers, size_t consumers, uint64_t items) {
+  std::atomic<uint64_t> consumed{0};
+  std::atomic<uint64_t> checksum{0};
+  std::vector<std::thread> threads;
+  auto start = Clock::now();
+  for (size_t ppp = 0; ppp < producers; ++ppp) {
+    threads.emplace_back([&, ppp] {
+      for (uint64_t value = ppp + 1; value <= items; value += producers) {
+        while (!queue.TryPush(value)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (size_t ccc = 0; ccc < consumers; ++ccc) {
+    threads.emplace_back([&] {
+      uint64_t sum = 0;
+      uint64_t value;
+      while (consumed.load(std::memory_order_relaxed) < items) {
+        if (queue.TryPop(value)) {
+          sum += value;
+          consumed.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+      checksum.fetch_add(sum);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  bool ok = consumed.load() == items &&
+            checksum.load() == items * (items + 1) / 2;
+  return {items / elapsed.count(), ok};
+}
+
+template <typename Queue>
+Result Best(size_t repeats, size_t producers, size_t consumers,
+            uint64_t items) {
+  Result best{0, true};
+  for (size_t rep = 0; rep < repeats; ++rep) {
+    Queue queue(kQueueCapacity);
+    Result result = Run(queue, producers, consumers, items);
+    best.ops_per_second = std::max(best.ops_per_second, result.ops_per_second);
+    best.ok = best.ok && result.ok;
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool quick = argc > 1 && std::string(argv[1]) == "--quick";
+  std::vector<size_t> counts =
+      quick ? std::vector<size_t>{1, 2} : std::vector<size_t>{1, 2, 4, 8};
+  uint64_t items = quick ? 100000 : 4000000;
+  size_t repeats = quick ? 1 : 3;
+
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency()
+            << ", queue capacity " << kQueueCapacity << ", " << items
+            << " items per run\n";
+  std::cout << std::setw(10) << "producers" << std::setw(10) << "consumers"
+            << std::setw(12) << "mpmc Mop/s" << std::setw(13) << "mutex Mop/s"
+            << std::setw(12) << "spsc Mop/s" << "\n";
+  bool ok = true;
+  for (size_t producers : counts) {
+    for (size_t consumers : counts) {
+      Result mpmc = Best<MpmcRingBuffer<uint64_t>>(repeats, producers,
+                                                   consumers, items);
+      Result locked =
+          Best<LockedRingBuffer>(repeats, producers, consumers, items);
+      ok = ok && mpmc.ok && locked.ok;
+      std::cout << std::fixed << std::setprecision(2) << std::setw(10)
+                << producers << std::setw(10) << consumers << std::setw(12)
+                << mpmc.ops_per_second * 1e-6 << std::setw(13)
+                << locked.ops_per_second * 1e-6;
+      if (producers == 1 && consumers == 1) {
+        Result spsc = Best<SpscRingBuffer<uint64_t>>(repeats, 1, 1, items);
+        ok = ok && spsc.ok;
+        std::cout << std::setw(12) << spsc.ops_per_second * 1e-6;
+      }
+      std::cout << "\n";
+    }
+  }
+  if (!ok) {
+    std::cout << "FAILED: an item was lost or duplicated\n";
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+#include "ring_buffer.hpp"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Pushes and pops in uneven bursts so that the positions run around the
+// array many times, checking the queue against a vector model.
+template <typename Queue>
+void ExpectFifoAcrossWrapAround(Queue& queue) {
+  std::vector<int> model;
+  size_t model_head = 0;
+  int next = 0;
+  for (int round = 0; round < 200; ++round) {
+    for (int i = 0; i < round % 5 + 1; ++i) {
+      bool pushed = queue.TryPush(next);
+      ASSERT_EQ(pushed, model.size() - model_head < queue.Capacity());
+      if (pushed) {
+        model.push_back(next);
+      }
+      ++next;
+    }
+    for (int i = 0; i < round % 3 + 1; ++i) {
+      int element = -1;
+      bool popped = queue.TryPop(&element);
+      ASSERT_EQ(popped, model_head < model.size());
+      if (popped) {
+        ASSERT_EQ(element, model[model_head++]);
+      }
+    }
+    ASSERT_EQ(queue.Size(), model.size() - model_head);
+  }
+}
+
+// Fills the queue, checks that a full push and an empty pop change
+// nothing, then drains it in order.
+template <typename Queue>
+void ExpectFullAndEmpty(Queue& queue, size_t capacity) {
+  EXPECT_EQ(queue.Capacity(), capacity);
+  EXPECT_TRUE(queue.Empty());
+  int element = -1;
+  EXPECT_FALSE(queue.TryPop(&element));
+  EXPECT_EQ(element, -1);
+  for (size_t i = 0; i < capacity; ++i) {
+    ASSERT_TRUE(queue.TryPush(static_cast<int>(i)));
+  }
+  EXPECT_EQ(queue.Size(), capacity);
+  EXPECT_FALSE(queue.TryPush(-2));
+  EXPECT_EQ(queue.Size(), capacity);
+  for (size_t i = 0; i < capacity; ++i) {
+    ASSERT_TRUE(queue.TryPop(element));
+    EXPECT_EQ(element, static_cast<int>(i));
+  }
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_FALSE(queue.TryPop(element));
+}
+
+// No default constructor; counts the live instances in *live.
+class Tracked {
+ public:
+  Tracked(int value, std::string name, int* live)
+      : value_(value), name_(std::move(name)), live_(live) {
+    ++*live_;
+  }
+  Tracked(const Tracked& other)
+      : value_(other.value_), name_(other.name_), live_(other.live_) {
+    ++*live_;
+  }
+  Tracked(Tracked&& other) noexcept
+      : value_(other.value_), name_(std::move(other.name_)),
+        live_(other.live_) {
+    ++*live_;
+  }
+  Tracked& operator=(const Tracked& other) = default;
+  Tracked& operator=(Tracked&& other) noexcept = default;
+  ~Tracked() { --*live_; }
+
+  int Value() const { return value_; }
+  const std::string& Name() const { return name_; }
+
+ private:
+  int value_;
+  std::string name_;
+  int* live_;
+};
+
+// Emplaces non-default-constructible elements around the wrap point and
+// checks that the queue destroys exactly the ones still queued.
+template <typename Queue, typename... Args>
+void ExpectQueuedElementsDestroyed(Args... args) {
+  int live = 0;
+  {
+    Queue queue(args...);
+    Tracked out(-1, "out", &live);
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_TRUE(queue.TryEmplace(i, "element " + std::to_string(i), &live));
+    }
+    for (int i = 0; i < 2; ++i) {
+      ASSERT_TRUE(queue.TryPop(out));
+      EXPECT_EQ(out.Value(), i);
+    }
+    Tracked copy(7, "copied", &live);
+    ASSERT_TRUE(queue.TryPush(copy));
+    ASSERT_TRUE(queue.TryPush(Tracked(8, "moved", &live)));
+    ASSERT_TRUE(queue.TryEmplace(9, std::string(100, 'x'), &live));
+    ASSERT_FALSE(queue.TryEmplace(10, "rejected", &live));
+    // out, copy and the four queued elements.
+    EXPECT_EQ(live, 6);
+    ASSERT_TRUE(queue.TryPop(out));
+    EXPECT_EQ(out.Value(), 2);
+    EXPECT_EQ(out.Name(), "element 2");
+    EXPECT_EQ(live, 5);
+  }
+  EXPECT_EQ(live, 0);
+}
+
+// Construction from a negative value throws.
+class ThrowsOnNegative {
+ public:
+  explicit ThrowsOnNegative(int value) : value_(value) {
+    if (value < 0) {
+      throw std::invalid_argument("negative");
+    }
+  }
+
+  int Value() const { return value_; }
+
+ private:
+  int value_;
+};
+
+}  // namespace
+
+TEST(RingBuffer, FifoAcrossWrapAround) {
+  RingBuffer<int, 3> fixed;
+  ExpectFifoAcrossWrapAround(fixed);
+  RingBuffer<int> dynamic(5);
+  ExpectFifoAcrossWrapAround(dynamic);
+  RingBuffer<int> power_of_two(4);
+  ExpectFifoAcrossWrapAround(power_of_two);
+}
+
+TEST(RingBuffer, FullAndEmpty) {
+  RingBuffer<int, 5> fixed;
+  ExpectFullAndEmpty(fixed, 5);
+  RingBuffer<int> dynamic(7);
+  ExpectFullAndEmpty(dynamic, 7);
+  // Again from positions that are no longer zero.
+  ExpectFullAndEmpty(dynamic, 7);
+  RingBuffer<int> one(1);
+  ExpectFullAndEmpty(one, 1);
+}
+
+TEST(RingBuffer, ZeroCapacity) {
+  RingBuffer<int, 0> fixed;
+  ExpectFullAndEmpty(fixed, 0);
+  EXPECT_FALSE(fixed.TryPush(1));
+  RingBuffer<int> dynamic(0);
+  ExpectFullAndEmpty(dynamic, 0);
+  EXPECT_FALSE(dynamic.TryPush(1));
+}
+
+TEST(RingBuffer, CapacityPastLargestPowerOfTwoThrows) {
+  const size_t kTooLarge = (static_cast<size_t>(-1) >> 1) + 2;
+  EXPECT_THROW(RingBuffer<int>{kTooLarge}, std::length_error);
+  EXPECT_THROW(SpscRingBuffer<int>{kTooLarge}, std::length_error);
+  EXPECT_THROW(MpmcRingBuffer<int>{static_cast<size_t>(-1)},
+               std::length_error);
+}
+
+TEST(SpscRingBuffer, FifoAcrossWrapAround) {
+  SpscRingBuffer<int, 3> fixed;
+  ExpectFifoAcrossWrapAround(fixed);
+  SpscRingBuffer<int> dynamic(5);
+  ExpectFifoAcrossWrapAround(dynamic);
+}
+
+TEST(SpscRingBuffer, FullAndEmpty) {
+  SpscRingBuffer<int, 5> fixed;
+  ExpectFullAndEmpty(fixed, 5);
+  ExpectFullAndEmpty(fixed, 5);
+  SpscRingBuffer<int> dynamic(7);
+  ExpectFullAndEmpty(dynamic, 7);
+}
+
+TEST(SpscRingBuffer, ZeroCapacity) {
+  SpscRingBuffer<int, 0> fixed;
+  ExpectFullAndEmpty(fixed, 0);
+  EXPECT_FALSE(fixed.TryPush(1));
+  SpscRingBuffer<int> dynamic(0);
+  ExpectFullAndEmpty(dynamic, 0);
+  EXPECT_FALSE(dynamic.TryPush(1));
+}
+
+TEST(RingBuffer, EmplacesAndDestroysInPlace) {
+  ExpectQueuedElementsDestroyed<RingBuffer<Tracked, 4>>();
+  ExpectQueuedElementsDestroyed<RingBuffer<Tracked>>(size_t(4));
+}
+
+TEST(SpscRingBuffer, EmplacesAndDestroysInPlace) {
+  ExpectQueuedElementsDestroyed<SpscRingBuffer<Tracked, 4>>();
+  ExpectQueuedElementsDestroyed<SpscRingBuffer<Tracked>>(size_t(4));
+}
+
+TEST(SpscRingBuffer, OrderUnderStress) {
+  const uint64_t kItems = 200000;
+  SpscRingBuffer<uint64_t> queue(8);
+  std::thread producer([&] {
+    for (uint64_t i = 0; i < kItems; ++i) {
+      while (!queue.TryPush(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  uint64_t expected = 0;
+  uint64_t out_of_order = 0;
+  uint64_t element;
+  while (expected < kItems) {
+    if (queue.TryPop(element)) {
+      out_of_order += element != expected;
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_EQ(out_of_order, 0u);
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST(MpmcRingBuffer, FifoAcrossWrapAround) {
+  MpmcRingBuffer<int, 3> fixed;
+  ExpectFifoAcrossWrapAround(fixed);
+  MpmcRingBuffer<int> dynamic(5);
+  ExpectFifoAcrossWrapAround(dynamic);
+}
+
+TEST(MpmcRingBuffer, CapacityIsTheRequestedBound) {
+  MpmcRingBuffer<int, 3> fixed;
+  ExpectFullAndEmpty(fixed, 3);
+  ExpectFullAndEmpty(fixed, 3);
+  MpmcRingBuffer<int> dynamic(5);
+  ExpectFullAndEmpty(dynamic, 5);
+  MpmcRingBuffer<int> power_of_two(8);
+  ExpectFullAndEmpty(power_of_two, 8);
+  MpmcRingBuffer<int, 1> one;
+  ExpectFullAndEmpty(one, 1);
+  MpmcRingBuffer<int> zero(0);
+  ExpectFullAndEmpty(zero, 0);
+  EXPECT_FALSE(zero.TryPush(1));
+}
+
+TEST(MpmcRingBuffer, EmplacesAndDestroysInPlace) {
+  ExpectQueuedElementsDestroyed<MpmcRingBuffer<Tracked, 4>>();
+  ExpectQueuedElementsDestroyed<MpmcRingBuffer<Tracked>>(size_t(4));
+}
+
+TEST(MpmcRingBuffer, ThrowingConstructorDoesNotWedge) {
+  MpmcRingBuffer<ThrowsOnNegative> queue(2);
+  EXPECT_THROW(queue.TryEmplace(-1), std::invalid_argument);
+  EXPECT_TRUE(queue.Empty());
+  ASSERT_TRUE(queue.TryEmplace(1));
+  EXPECT_THROW(queue.TryEmplace(-2), std::invalid_argument);
+  ASSERT_TRUE(queue.TryEmplace(2));
+  EXPECT_FALSE(queue.TryEmplace(3));
+  ThrowsOnNegative out(0);
+  ASSERT_TRUE(queue.TryPop(out));
+  EXPECT_EQ(out.Value(), 1);
+  ASSERT_TRUE(queue.TryPop(out));
+  EXPECT_EQ(out.Value(), 2);
+  EXPECT_FALSE(queue.TryPop(out));
+}
+
+TEST(MpmcRingBuffer, EveryItemOnceUnderStress) {
+  const size_t kProducers = 3;
+  const size_t kConsumers = 2;
+  const uint64_t kPerProducer = 50000;
+  // Not a power of two, so the bound check against dequeue_ runs too.
+  MpmcRingBuffer<uint64_t> queue(6);
+  std::vector<std::vector<uint64_t>> received(kConsumers);
+  std::atomic<uint64_t> remaining{kProducers * kPerProducer};
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < kProducers; ++p) {
+    threads.emplace_back([&, p] {
+      for (uint64_t i = 0; i < kPerProducer; ++i) {
+        while (!queue.TryPush(p * kPerProducer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (size_t c = 0; c < kConsumers; ++c) {
+    threads.emplace_back([&, c] {
+      uint64_t element;
+      while (remaining.load() > 0) {
+        if (queue.TryPop(element)) {
+          received[c].push_back(element);
+          remaining.fetch_sub(1);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  std::vector<bool> seen(kProducers * kPerProducer);
+  size_t duplicates = 0;
+  size_t out_of_order = 0;
+  for (const std::vector<uint64_t>& items : received) {
+    // Items of one producer reach one consumer in the order pushed.
+    std::vector<int64_t> last(kProducers, -1);
+    for (uint64_t item : items) {
+      duplicates += seen[item];
+      seen[item] = true;
+      int64_t& previous = last[item / kPerProducer];
+      out_of_order += static_cast<int64_t>(item) <= previous;
+      previous = static_cast<int64_t>(item);
+    }
+  }
+  EXPECT_EQ(duplicates, 0u);
+  EXPECT_EQ(out_of_order, 0u);
+  EXPECT_EQ(std::count(seen.begin(), seen.end(), true),
+            static_cast<std::ptrdiff_t>(kProducers * kPerProducer));
+  EXPECT_TRUE(queue.Empty());
+}
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
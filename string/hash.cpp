@@ -0,0 +1,89 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+namespace string_hash {
+
+namespace {
+
+const uint64_t kSecret[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+                             0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+// Full 128-bit product of a and b, split into its low and high halves.
+void Multiply(uint64_t* a, uint64_t* b) {
+  unsigned __int128 product = static_cast<unsigned __int128>(*a) * *b;
+  *a = static_cast<uint64_t>(product);
+  *b = static_cast<uint64_t>(product >> 64);
+}
+
+uint64_t Mix(uint64_t a, uint64_t b) {
+  Multiply(&a, &b);
+  return a ^ b;
+}
+
+uint64_t Read8(const unsigned char* ptr) {
+  uint64_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+uint64_t Read4(const unsigned char* ptr) {
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+// 1 to 3 bytes: first, middle and last, which may coincide.
+uint64_t Read3(const unsigned char* ptr, size_t size) {
+  return (static_cast<uint64_t>(ptr[0]) << 16) |
+         (static_cast<uint64_t>(ptr[size >> 1]) << 8) | ptr[size - 1];
+}
+
+}  // namespace
+
+uint64_t Hash(const char* data, size_t size, uint64_t seed) {
+  const unsigned char* ptr = reinterpret_cast<const unsigned char*>(data);
+  seed ^= Mix(seed ^ kSecret[0], kSecret[1]);
+  uint64_t a;
+  uint64_t b;
+  if (size <= 16) {
+    if (size >= 4) {
+      size_t middle = (size >> 3) << 2;
+      a = (Read4(ptr) << 32) | Read4(ptr + middle);
+      b = (Read4(ptr + size - 4) << 32) | Read4(ptr + size - 4 - middle);
+    } else if (size > 0) {
+      a = Read3(ptr, size);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t left = size;
+    if (left > 48) {
+      uint64_t lane1 = seed;
+      uint64_t lane2 = seed;
+      do {
+        seed = Mix(Read8(ptr) ^ kSecret[1], Read8(ptr + 8) ^ seed);
+        lane1 = Mix(Read8(ptr + 16) ^ kSecret[2], Read8(ptr + 24) ^ lane1);
+        lane2 = Mix(Read8(ptr + 32) ^ kSecret[3], Read8(ptr + 40) ^ lane2);
+        ptr += 48;
+        left -= 48;
+      } while (left > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    while (left > 16) {
+      seed = Mix(Read8(ptr) ^ kSecret[1], Read8(ptr + 8) ^ seed);
+      ptr += 16;
+      left -= 16;
+    }
+    // The last 16 bytes, overlapping what was already mixed if need be.
+    a = Read8(ptr + left - 16);
+    b = Read8(ptr + left - 8);
+  }
+  a ^= kSecret[1];
+  b ^= seed;
+  Multiply(&a, &b);
+  return Mix(a ^ kSecret[0] ^ size, b ^ kSecret[1]);
+}
+
+}  // namespace string_hash
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fast non-cryptographic hashing of byte ranges, used by std::hash<String>
+// and std::hash<StringView>. Not suitable where an attacker chooses the keys
+// and the seed is known.
+namespace string_hash {
+
+// wyhash (final version): inputs up to 16 bytes take two overlapping loads
+// and one 64x64->128 multiply; longer inputs are consumed 48 bytes per
+// iteration in three independent multiply chains.
+uint64_t Hash(const char* data, size_t size, uint64_t seed = 0);
+
+}  // namespace string_hash
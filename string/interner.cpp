@@ -0,0 +1,73 @@
+#include "interner.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+const size_t Interner::kShards;
+const size_t Interner::kBlockSize;
+
+Atom::Atom(StringView text) : Atom(Interner::Global().Intern(text)) {}
+
+Interner& Interner::Global() {
+  // Leaked on purpose so that atoms stay valid during static destruction.
+  static Interner* interner = new Interner;
+  return *interner;
+}
+
+// Bump-allocates header, characters and a terminating zero. Texts larger
+// than a block get a block of their own, leaving the current one in use.
+const Atom::Entry* Interner::Allocate(Shard& shard, StringView text,
+                                      uint64_t hash) {
+  const size_t kAlign = alignof(Atom::Entry);
+  size_t bytes = (sizeof(Atom::Entry) + text.Size() + 1 + kAlign - 1) &
+                 ~(kAlign - 1);
+  char* memory;
+  if (bytes > kBlockSize / 4) {
+    shard.blocks.emplace_back(new char[bytes]);
+    memory = shard.blocks.back().get();
+  } else {
+    if (shard.free_size < bytes) {
+      shard.blocks.emplace_back(new char[kBlockSize]);
+      shard.free = shard.blocks.back().get();
+      shard.free_size = kBlockSize;
+    }
+    memory = shard.free;
+    shard.free += bytes;
+    shard.free_size -= bytes;
+  }
+  auto* entry = new (memory) Atom::Entry{hash, text.Size()};
+  char* chars = reinterpret_cast<char*>(entry + 1);
+  if (!text.Empty()) {
+    memcpy(chars, text.Data(), text.Size());
+  }
+  chars[text.Size()] = '\0';
+  return entry;
+}
+
+Atom Interner::Intern(StringView text) {
+  if (text.Empty()) {
+    return Atom();
+  }
+  uint64_t hash = string_hash::Hash(text.Data(), text.Size());
+  // The low bits feed the shard's own table; use the high ones here.
+  Shard& shard = shards_[hash >> 60 & (kShards - 1)];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto found = shard.index.find(Key{text, hash});
+  if (found != shard.index.end()) {
+    return Atom(found->second);
+  }
+  const Atom::Entry* entry = Allocate(shard, text, hash);
+  StringView stored(reinterpret_cast<const char*>(entry + 1), text.Size());
+  shard.index.emplace(Key{stored, hash}, entry);
+  return Atom(entry);
+}
+
+size_t Interner::Size() {
+  size_t total = 0;
+  for (Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.index.size();
+  }
+  return total;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.hpp"
+#include "string.hpp"
+
+class Interner;
+
+// Handle to an interned, immutable string: one pointer wide, compared by
+// address, with the hash computed once at interning time. Two atoms from
+// the same Interner are equal exactly when their texts are equal. An atom
+// stays valid for as long as its Interner; atoms made with the StringView
+// constructor use Interner::Global(), which is never destroyed.
+class Atom {
+ private:
+  // Header stored in the arena directly in front of the characters.
+  struct Entry {
+    uint64_t hash;
+    size_t size;
+  };
+
+  const Entry* entry_ = nullptr;
+
+  explicit Atom(const Entry* entry) : entry_(entry) {}
+
+  friend class Interner;
+
+ public:
+  // The empty string.
+  Atom() = default;
+  explicit Atom(StringView text);
+
+  size_t Size() const { return entry_ == nullptr ? 0 : entry_->size; }
+  bool Empty() const { return Size() == 0; }
+  const char* Data() const {
+    return entry_ == nullptr ? "" : reinterpret_cast<const char*>(entry_ + 1);
+  }
+  size_t Hash() const {
+    return entry_ == nullptr ? string_hash::Hash(nullptr, 0) : entry_->hash;
+  }
+  operator StringView() const { return {Data(), Size()}; }
+  String ToString() const { return String(StringView(*this)); }
+
+  bool operator==(Atom other) const { return entry_ == other.entry_; }
+  bool operator!=(Atom other) const { return entry_ != other.entry_; }
+
+  friend std::ostream& operator<<(std::ostream& oos, Atom atom) {
+    return oos << StringView(atom);
+  }
+};
+
+// Thread-safe string table. Texts are copied once into arena blocks that
+// are only released with the Interner itself. The table is split into
+// kShards shards picked by hash, each with its own mutex, so concurrent
+// Intern calls for different texts rarely contend.
+class Interner {
+ private:
+  static const size_t kShards = 16;
+  static const size_t kBlockSize = 1 << 16;
+
+  struct Key {
+    StringView text;
+    uint64_t hash;
+    bool operator==(const Key& other) const { return text == other.text; }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const { return key.hash; }
+  };
+
+  // alignas keeps neighbouring shards' mutexes off one cache line.
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_map<Key, const Atom::Entry*, KeyHash> index;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* free = nullptr;
+    size_t free_size = 0;
+  };
+
+  Shard shards_[kShards];
+
+  static const Atom::Entry* Allocate(Shard& shard, StringView text,
+                                     uint64_t hash);
+
+ public:
+  Interner() = default;
+  Interner(const Interner&) = delete;
+  Interner& operator=(const Interner&) = delete;
+
+  // The process-wide table behind Atom(StringView).
+  static Interner& Global();
+
+  Atom Intern(StringView text);
+  // Number of distinct non-empty texts interned so far.
+  size_t Size();
+};
+
+namespace std {
+
+template <>
+struct hash<Atom> {
+  size_t operator()(Atom atom) const noexcept { return atom.Hash(); }
+};
+
+}  // namespace std
@@ -0,0 +1,171 @@
+#include "rope.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+const size_t Rope::kMergeLimit;
+
+Rope::NodePtr Rope::MakeLeaf(std::shared_ptr<const String> chunk,
+                             size_t offset, size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  auto node = std::make_shared<Node>();
+  node->chunk = std::move(chunk);
+  node->offset = offset;
+  node->size = size;
+  return node;
+}
+
+Rope::NodePtr Rope::MakeNode(NodePtr left, NodePtr right) {
+  auto node = std::make_shared<Node>();
+  node->size = left->size + right->size;
+  node->height = 1 + std::max(left->height, right->height);
+  node->left = std::move(left);
+  node->right = std::move(right);
+  return node;
+}
+
+// Node over left and right, whose heights differ by at most two, with one
+// single or double rotation when they differ by two.
+Rope::NodePtr Rope::Balance(NodePtr left, NodePtr right) {
+  if (left->height > right->height + 1) {
+    if (Height(left->left) >= Height(left->right)) {
+      return MakeNode(left->left, MakeNode(left->right, std::move(right)));
+    }
+    const NodePtr& inner = left->right;
+    return MakeNode(MakeNode(left->left, inner->left),
+                    MakeNode(inner->right, std::move(right)));
+  }
+  if (right->height > left->height + 1) {
+    if (Height(right->right) >= Height(right->left)) {
+      return MakeNode(MakeNode(std::move(left), right->left), right->right);
+    }
+    const NodePtr& inner = right->left;
+    return MakeNode(MakeNode(std::move(left), inner->left),
+                    MakeNode(inner->right, right->right));
+  }
+  return MakeNode(std::move(left), std::move(right));
+}
+
+// AVL join: descend the spine of the taller tree until the heights are
+// within one, attach there, and rebalance on the way back up. O(height
+// difference).
+Rope::NodePtr Rope::Join(const NodePtr& left, const NodePtr& right) {
+  if (!left) {
+    return right;
+  }
+  if (!right) {
+    return left;
+  }
+  if (left->height > right->height + 1) {
+    return Balance(left->left, Join(left->right, right));
+  }
+  if (right->height > left->height + 1) {
+    return Balance(Join(left, right->left), right->right);
+  }
+  if (left->chunk && right->chunk && left->size + right->size <= kMergeLimit) {
+    String merged(left->size + right->size, '\0');
+    memcpy(&merged[0], left->chunk->Data() + left->offset, left->size);
+    memcpy(&merged[left->size], right->chunk->Data() + right->offset,
+           right->size);
+    size_t size = merged.Size();
+    return MakeLeaf(std::make_shared<const String>(std::move(merged)), 0,
+                    size);
+  }
+  return MakeNode(left, right);
+}
+
+// (first pos characters, the rest). Leaves are sliced, not copied.
+std::pair<Rope::NodePtr, Rope::NodePtr> Rope::Split(const NodePtr& node,
+                                                    size_t pos) {
+  if (!node) {
+    return {nullptr, nullptr};
+  }
+  if (node->chunk) {
+    return {MakeLeaf(node->chunk, node->offset, pos),
+            MakeLeaf(node->chunk, node->offset + pos, node->size - pos)};
+  }
+  if (pos <= node->left->size) {
+    auto parts = Split(node->left, pos);
+    return {parts.first, Join(parts.second, node->right)};
+  }
+  auto parts = Split(node->right, pos - node->left->size);
+  return {Join(node->left, parts.first), parts.second};
+}
+
+Rope::Rope(const char* cstr) : Rope(StringView(cstr)) {}
+
+Rope::Rope(StringView view) : Rope(String(view)) {}
+
+Rope::Rope(String&& text) {
+  size_t size = text.Size();
+  root_ = MakeLeaf(std::make_shared<const String>(std::move(text)), 0, size);
+}
+
+char Rope::operator[](size_t index) const {
+  if (index >= Size()) {
+    throw std::out_of_range("Rope::operator[]: index out of range");
+  }
+  const Node* node = root_.get();
+  while (!node->chunk) {
+    if (index < node->left->size) {
+      node = node->left.get();
+    } else {
+      index -= node->left->size;
+      node = node->right.get();
+    }
+  }
+  return (*node->chunk)[node->offset + index];
+}
+
+Rope& Rope::operator+=(const Rope& other) {
+  root_ = Join(root_, other.root_);
+  return *this;
+}
+
+Rope operator+(const Rope& first, const Rope& second) {
+  return Rope(Rope::Join(first.root_, second.root_));
+}
+
+Rope Rope::Substr(size_t pos, size_t count) const {
+  if (pos > Size()) {
+    throw std::out_of_range("Rope::Substr: position past the end");
+  }
+  count = std::min(count, Size() - pos);
+  auto tail = Split(root_, pos).second;
+  return Rope(Split(tail, count).first);
+}
+
+void Rope::Insert(size_t pos, const Rope& other) {
+  if (pos > Size()) {
+    throw std::out_of_range("Rope::Insert: position past the end");
+  }
+  auto parts = Split(root_, pos);
+  root_ = Join(Join(parts.first, other.root_), parts.second);
+}
+
+void Rope::Erase(size_t pos, size_t count) {
+  if (pos > Size()) {
+    throw std::out_of_range("Rope::Erase: position past the end");
+  }
+  count = std::min(count, Size() - pos);
+  auto parts = Split(root_, pos);
+  root_ = Join(parts.first, Split(parts.second, count).second);
+}
+
+String Rope::ToString() const {
+  String result(Size(), '\0');
+  size_t pos = 0;
+  ForEachChunk([&](StringView chunk) {
+    memcpy(result.MutableData() + pos, chunk.Data(), chunk.Size());
+    pos += chunk.Size();
+  });
+  return result;
+}
+
+std::ostream& operator<<(std::ostream& oos, const Rope& rope) {
+  rope.ForEachChunk([&](StringView chunk) { oos << chunk; });
+  return oos;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+#include "string.hpp"
+
+// Text as a height-balanced (AVL) tree of immutable, reference-counted
+// chunks. Concatenation, Substr, Insert and Erase take O(log n) and copy
+// no characters: leaves share their chunk and only the O(log n) nodes on
+// the affected paths are rebuilt. Copying a Rope is O(1) and the copies
+// share all nodes. Use ToString to flatten when contiguous text is needed.
+class Rope {
+ private:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  // A leaf holds chunk[offset, offset + size); an inner node holds the
+  // concatenation of left and right.
+  struct Node {
+    std::shared_ptr<const String> chunk;
+    size_t offset = 0;
+    size_t size = 0;
+    size_t height = 1;
+    NodePtr left;
+    NodePtr right;
+  };
+
+  // Adjacent leaves shorter than this together are merged into one chunk,
+  // so building a Rope from many small pieces does not produce a tree of
+  // tiny leaves.
+  static const size_t kMergeLimit = 256;
+
+  NodePtr root_;
+
+  explicit Rope(NodePtr root) : root_(std::move(root)) {}
+
+  static size_t Height(const NodePtr& node) {
+    return node ? node->height : 0;
+  }
+  static NodePtr MakeLeaf(std::shared_ptr<const String> chunk, size_t offset,
+                          size_t size);
+  static NodePtr MakeNode(NodePtr left, NodePtr right);
+  static NodePtr Balance(NodePtr left, NodePtr right);
+  static NodePtr Join(const NodePtr& left, const NodePtr& right);
+  static std::pair<NodePtr, NodePtr> Split(const NodePtr& node, size_t pos);
+
+  template <typename Fn>
+  static void Visit(const NodePtr& node, Fn& fn) {
+    if (!node) {
+      return;
+    }
+    if (node->chunk) {
+      fn(StringView(node->chunk->Data() + node->offset, node->size));
+      return;
+    }
+    Visit(node->left, fn);
+    Visit(node->right, fn);
+  }
+
+ public:
+  Rope() = default;
+  Rope(const char* cstr);
+  Rope(StringView view);
+  Rope(String&& text);
+
+  size_t Size() const { return root_ ? root_->size : 0; }
+  bool Empty() const { return Size() == 0; }
+  // Depth of the tree, O(log(number of chunks)).
+  size_t Height() const { return Height(root_); }
+
+  // O(log n); throws std::out_of_range when index >= Size().
+  char operator[](size_t index) const;
+
+  Rope& operator+=(const Rope& other);
+  friend Rope operator+(const Rope& first, const Rope& second);
+
+  Rope Substr(size_t pos, size_t count) const;
+  void Insert(size_t pos, const Rope& other);
+  void Erase(size_t pos, size_t count);
+
+  String ToString() const;
+
+  // Calls fn(StringView) for every chunk, in order.
+  template <typename Fn>
+  void ForEachChunk(Fn fn) const {
+    Visit(root_, fn);
+  }
+
+  friend std::ostream& operator<<(std::ostream& oos, const Rope& rope);
+};
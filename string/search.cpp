@@ -0,0 +1,430 @@
+#include "search.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRING_SEARCH_X86 1
+#endif
+
+namespace string_search {
+
+namespace {
+
+#ifdef STRING_SEARCH_X86
+bool HasAvx2() {
+  static const bool kSupported = __builtin_cpu_supports("avx2");
+  return kSupported;
+}
+
+bool HasSse42() {
+  static const bool kSupported = __builtin_cpu_supports("sse4.2");
+  return kSupported;
+}
+
+// Compares 32 candidate positions at once: a position survives when both
+// the first and the last needle byte match there, and only survivors are
+// checked with memcmp. Needs needle_size >= 2.
+//
+// When `stop` is set, the bytes spent in memcmp are bounded by a constant
+// times the bytes scanned; past that the search gives up, stores the first
+// unexamined position in *stop and returns kNotFound so that the caller
+// can continue with a linear-time algorithm.
+__attribute__((target("avx2"))) size_t FilterFind(const char* haystack,
+                                                  size_t size,
+                                                  const char* needle,
+                                                  size_t needle_size,
+                                                  size_t* stop = nullptr) {
+  const size_t kVerifyBudgetSlack = 4096;
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_size - 1]);
+  size_t verified = 0;
+  size_t pos = 0;
+  for (; pos + needle_size + 31 <= size; pos += 32) {
+    if (stop != nullptr && verified > 4 * pos + kVerifyBudgetSlack) {
+      *stop = pos;
+      return kNotFound;
+    }
+    __m256i block_first = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(haystack + pos));
+    __m256i block_last = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(haystack + pos + needle_size - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last))));
+    while (mask != 0) {
+      size_t candidate = pos + __builtin_ctz(mask);
+      if (memcmp(haystack + candidate + 1, needle + 1, needle_size - 2) == 0) {
+        return candidate;
+      }
+      verified += needle_size;
+      mask &= mask - 1;
+    }
+  }
+  if (stop != nullptr && pos + needle_size <= size &&
+      verified > 4 * pos + kVerifyBudgetSlack) {
+    *stop = pos;
+    return kNotFound;
+  }
+  for (; pos + needle_size <= size; ++pos) {
+    if (haystack[pos] == needle[0] &&
+        memcmp(haystack + pos + 1, needle + 1, needle_size - 1) == 0) {
+      return pos;
+    }
+  }
+  return kNotFound;
+}
+
+// The same filter run from the end of haystack towards the start. With
+// `stop` set it gives up under the same budget as FilterFind; positions
+// below *stop are then left unexamined.
+__attribute__((target("avx2"))) size_t FilterRFind(const char* haystack,
+                                                   size_t size,
+                                                   const char* needle,
+                                                   size_t needle_size,
+                                                   size_t* stop = nullptr) {
+  const size_t kVerifyBudgetSlack = 4096;
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_size - 1]);
+  size_t verified = 0;
+  // Candidates [end - 32, end) are checked per step.
+  const size_t candidates = size - needle_size + 1;
+  size_t end = candidates;
+  for (; end >= 32; end -= 32) {
+    if (stop != nullptr &&
+        verified > 4 * (candidates - end) + kVerifyBudgetSlack) {
+      *stop = end;
+      return kNotFound;
+    }
+    size_t pos = end - 32;
+    __m256i block_first = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(haystack + pos));
+    __m256i block_last = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(haystack + pos + needle_size - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last))));
+    while (mask != 0) {
+      size_t candidate = pos + 31 - __builtin_clz(mask);
+      if (memcmp(haystack + candidate + 1, needle + 1, needle_size - 2) == 0) {
+        return candidate;
+      }
+      verified += needle_size;
+      mask &= ~(1u << (31 - __builtin_clz(mask)));
+    }
+  }
+  if (stop != nullptr && end > 0 &&
+      verified > 4 * (candidates - end) + kVerifyBudgetSlack) {
+    *stop = end;
+    return kNotFound;
+  }
+  while (end > 0) {
+    --end;
+    if (haystack[end] == needle[0] &&
+        memcmp(haystack + end + 1, needle + 1, needle_size - 1) == 0) {
+      return end;
+    }
+  }
+  return kNotFound;
+}
+
+// pcmpestri compares 16 haystack bytes against a set of up to 16 bytes
+// and reports the first hit.
+__attribute__((target("sse4.2"))) size_t SetFind(const char* haystack,
+                                                 size_t size, const char* set,
+                                                 size_t set_size) {
+  char set_bytes[16] = {};
+  memcpy(set_bytes, set, set_size);
+  const __m128i set_reg =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(set_bytes));
+  const int kMode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY |
+                    _SIDD_LEAST_SIGNIFICANT;
+  size_t pos = 0;
+  for (; pos + 16 <= size; pos += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + pos));
+    int index = _mm_cmpestri(set_reg, static_cast<int>(set_size), block, 16,
+                             kMode);
+    if (index < 16) {
+      return pos + index;
+    }
+  }
+  for (; pos < size; ++pos) {
+    if (memchr(set, haystack[pos], set_size) != nullptr) {
+      return pos;
+    }
+  }
+  return kNotFound;
+}
+#endif
+
+// Scalar first/last byte filter: memchr (itself vectorized in libc) finds
+// the next first-byte candidate.
+size_t ScalarFind(const char* haystack, size_t size, const char* needle,
+                  size_t needle_size) {
+  size_t pos = 0;
+  while (pos + needle_size <= size) {
+    const void* first =
+        memchr(haystack + pos, needle[0], size - needle_size + 1 - pos);
+    if (first == nullptr) {
+      return kNotFound;
+    }
+    pos = static_cast<const char*>(first) - haystack;
+    if (haystack[pos + needle_size - 1] == needle[needle_size - 1] &&
+        memcmp(haystack + pos, needle, needle_size) == 0) {
+      return pos;
+    }
+    ++pos;
+  }
+  return kNotFound;
+}
+
+size_t ScalarRFind(const char* haystack, size_t size, const char* needle,
+                   size_t needle_size) {
+  for (size_t end = size - needle_size + 1; end > 0; --end) {
+    if (haystack[end - 1] == needle[0] &&
+        memcmp(haystack + end - 1, needle, needle_size) == 0) {
+      return end - 1;
+    }
+  }
+  return kNotFound;
+}
+
+// size bytes read front to back, or back to front when kReversed, so that
+// one Two-Way implementation serves both Find and RFind.
+template <bool kReversed>
+class Bytes {
+ public:
+  Bytes(const char* data, size_t size)
+      : data_(reinterpret_cast<const unsigned char*>(data)), size_(size) {}
+  unsigned char operator[](size_t iii) const {
+    return kReversed ? data_[size_ - 1 - iii] : data_[iii];
+  }
+
+ private:
+  const unsigned char* data_;
+  size_t size_;
+};
+
+// Crochemore-Perrin Two-Way search with a bad-character shift on the last
+// window byte. Runs in O(size + length) time and O(1) extra space apart
+// from the 256-entry shift table. Returns the first match in the order
+// the Bytes are read.
+template <bool kReversed>
+size_t TwoWaySearch(Bytes<kReversed> haystack, size_t size,
+                    Bytes<kReversed> needle, size_t length) {
+  // shift[c] is one past the last position of c in needle, 0 if absent.
+  size_t shift[256] = {};
+  for (size_t iii = 0; iii < length; ++iii) {
+    shift[needle[iii]] = iii + 1;
+  }
+
+  // Critical factorization: the larger of the maximal suffixes under the
+  // two byte orders. Indices start at size_t(-1) and wrap on purpose.
+  size_t ip = kNotFound;
+  size_t jp = 0;
+  size_t kkk = 1;
+  size_t period = 1;
+  while (jp + kkk < length) {
+    if (needle[ip + kkk] == needle[jp + kkk]) {
+      if (kkk == period) {
+        jp += period;
+        kkk = 1;
+      } else {
+        ++kkk;
+      }
+    } else if (needle[ip + kkk] > needle[jp + kkk]) {
+      jp += kkk;
+      kkk = 1;
+      period = jp - ip;
+    } else {
+      ip = jp++;
+      kkk = period = 1;
+    }
+  }
+  size_t split = ip;
+  size_t first_period = period;
+
+  ip = kNotFound;
+  jp = 0;
+  kkk = period = 1;
+  while (jp + kkk < length) {
+    if (needle[ip + kkk] == needle[jp + kkk]) {
+      if (kkk == period) {
+        jp += period;
+        kkk = 1;
+      } else {
+        ++kkk;
+      }
+    } else if (needle[ip + kkk] < needle[jp + kkk]) {
+      jp += kkk;
+      kkk = 1;
+      period = jp - ip;
+    } else {
+      ip = jp++;
+      kkk = period = 1;
+    }
+  }
+  if (ip + 1 > split + 1) {
+    split = ip;
+  } else {
+    period = first_period;
+  }
+
+  // For a periodic needle a full-period shift keeps length - period bytes
+  // known to match; otherwise any shift past the split is safe.
+  size_t memory_after_shift;
+  kkk = 0;
+  while (kkk < split + 1 && needle[kkk] == needle[kkk + period]) {
+    ++kkk;
+  }
+  if (kkk < split + 1) {
+    memory_after_shift = 0;
+    period = (split > length - split - 1 ? split : length - split - 1) + 1;
+  } else {
+    memory_after_shift = length - period;
+  }
+
+  size_t memory = 0;
+  size_t pos = 0;
+  while (pos + length <= size) {
+    size_t last = shift[haystack[pos + length - 1]];
+    if (last != length) {
+      pos += length - last;
+      memory = 0;
+      continue;
+    }
+    // Right half, left to right.
+    kkk = split + 1 > memory ? split + 1 : memory;
+    while (kkk < length && needle[kkk] == haystack[pos + kkk]) {
+      ++kkk;
+    }
+    if (kkk < length) {
+      pos += kkk - split;
+      memory = 0;
+      continue;
+    }
+    // Left half, right to left.
+    kkk = split + 1;
+    while (kkk > memory && needle[kkk - 1] == haystack[pos + kkk - 1]) {
+      --kkk;
+    }
+    if (kkk <= memory) {
+      return pos;
+    }
+    pos += period;
+    memory = memory_after_shift;
+  }
+  return kNotFound;
+}
+
+size_t TwoWayFind(const char* haystack, size_t size, const char* needle,
+                  size_t needle_size) {
+  return TwoWaySearch(Bytes<false>(haystack, size), size,
+                      Bytes<false>(needle, needle_size), needle_size);
+}
+
+// Two-Way over the reversed haystack and needle: the first match there is
+// the last one here.
+size_t TwoWayRFind(const char* haystack, size_t size, const char* needle,
+                   size_t needle_size) {
+  size_t found = TwoWaySearch(Bytes<true>(haystack, size), size,
+                              Bytes<true>(needle, needle_size), needle_size);
+  return found == kNotFound ? kNotFound : size - needle_size - found;
+}
+
+}  // namespace
+
+size_t Find(const char* haystack, size_t size, const char* needle,
+            size_t needle_size) {
+  if (needle_size == 0) {
+    return 0;
+  }
+  if (needle_size > size) {
+    return kNotFound;
+  }
+  if (needle_size == 1) {
+    const void* hit = memchr(haystack, needle[0], size);
+    return hit == nullptr ? kNotFound
+                          : static_cast<const char*>(hit) - haystack;
+  }
+#ifdef STRING_SEARCH_X86
+  if (HasAvx2()) {
+    if (needle_size <= kFilterNeedleLimit) {
+      return FilterFind(haystack, size, needle, needle_size);
+    }
+    size_t stop = kNotFound;
+    size_t found = FilterFind(haystack, size, needle, needle_size, &stop);
+    if (stop == kNotFound) {
+      return found;
+    }
+    found = TwoWayFind(haystack + stop, size - stop, needle, needle_size);
+    return found == kNotFound ? kNotFound : stop + found;
+  }
+#endif
+  if (needle_size > kFilterNeedleLimit) {
+    return TwoWayFind(haystack, size, needle, needle_size);
+  }
+  return ScalarFind(haystack, size, needle, needle_size);
+}
+
+size_t RFind(const char* haystack, size_t size, const char* needle,
+             size_t needle_size) {
+  if (needle_size == 0) {
+    return size;
+  }
+  if (needle_size > size) {
+    return kNotFound;
+  }
+  if (needle_size == 1) {
+    const void* hit = memrchr(haystack, needle[0], size);
+    return hit == nullptr ? kNotFound
+                          : static_cast<const char*>(hit) - haystack;
+  }
+#ifdef STRING_SEARCH_X86
+  if (HasAvx2()) {
+    if (needle_size <= kFilterNeedleLimit) {
+      return FilterRFind(haystack, size, needle, needle_size);
+    }
+    size_t stop = kNotFound;
+    size_t found = FilterRFind(haystack, size, needle, needle_size, &stop);
+    if (stop == kNotFound) {
+      return found;
+    }
+    // Candidates below stop remain; they end before stop + needle_size - 1.
+    return TwoWayRFind(haystack, stop + needle_size - 1, needle, needle_size);
+  }
+#endif
+  if (needle_size > kFilterNeedleLimit) {
+    return TwoWayRFind(haystack, size, needle, needle_size);
+  }
+  return ScalarRFind(haystack, size, needle, needle_size);
+}
+
+size_t FindFirstOf(const char* haystack, size_t size, const char* set,
+                   size_t set_size) {
+  if (set_size == 0) {
+    return kNotFound;
+  }
+  if (set_size == 1) {
+    return Find(haystack, size, set, 1);
+  }
+#ifdef STRING_SEARCH_X86
+  if (set_size <= 16 && HasSse42()) {
+    return SetFind(haystack, size, set, set_size);
+  }
+#endif
+  bool member[256] = {};
+  for (size_t iii = 0; iii < set_size; ++iii) {
+    member[static_cast<unsigned char>(set[iii])] = true;
+  }
+  for (size_t pos = 0; pos < size; ++pos) {
+    if (member[static_cast<unsigned char>(haystack[pos])]) {
+      return pos;
+    }
+  }
+  return kNotFound;
+}
+
+}  // namespace string_search
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Substring and character-set search over raw byte ranges, used by
+// StringView and String. Every function returns an index into haystack,
+// or static_cast<size_t>(-1) when there is no match.
+namespace string_search {
+
+const size_t kNotFound = static_cast<size_t>(-1);
+
+// Needles up to this length use only the SIMD first/last byte filter, whose
+// worst case is bounded by the needle length. Longer needles start with the
+// filter too but switch to Two-Way, which is linear in the worst case, once
+// candidate verification costs more than scanning.
+const size_t kFilterNeedleLimit = 32;
+
+// First occurrence of needle.
+size_t Find(const char* haystack, size_t size, const char* needle,
+            size_t needle_size);
+
+// Last occurrence of needle.
+size_t RFind(const char* haystack, size_t size, const char* needle,
+             size_t needle_size);
+
+// First byte of haystack that occurs in set.
+size_t FindFirstOf(const char* haystack, size_t size, const char* set,
+                   size_t set_size);
+
+}  // namespace string_search
@@ -1,59 +1,210 @@
 #include "string.hpp"
 
+#include "search.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <utility>
 #include <vector>
 
-String::String(int size, char letter) : size_(size), capacity_(size_) {
-  string_ = new char[size_ + 1];
-  for (int i = 0; i < size; i++) {
-    string_[i] = letter;
+// Points string_ at storage for `size` characters (inline when it fits)
+// and sets size_; the characters themselves are left to the caller. The
+// string must be inline and empty.
+void String::Init(size_t size) {
+  size_ = size;
+  if (size > Capacity()) {
+    uintptr_t tag = Tag();
+    char* buffer = static_cast<char*>(ResourceOf(tag)->allocate(size + 1, 1));
+    heap_.tag = tag;
+    heap_.capacity = size;
+    string_ = buffer;
+  }
+}
+// Moves the characters into a buffer for new_cap >= size_ characters, back
+// inline when they fit there.
+void String::Reallocate(size_t new_cap) {
+  uintptr_t tag = Tag();
+  if (new_cap <= LocalCapacity(tag)) {
+    if (IsHeap()) {
+      char* heap = string_;
+      size_t heap_capacity = heap_.capacity;
+      SetLocal(tag);
+      memcpy(string_, heap, size_);
+      ResourceOf(tag)->deallocate(heap, heap_capacity + 1, 1);
+    }
+  } else {
+    char* buffer =
+        static_cast<char*>(ResourceOf(tag)->allocate(new_cap + 1, 1));
+    memcpy(buffer, string_, size_);
+    Release();
+    heap_.tag = tag;
+    heap_.capacity = new_cap;
+    string_ = buffer;
+  }
+  Zero();
+}
+// Returns a heap buffer to the resource; string_ is left dangling.
+void String::Release() {
+  if (IsHeap()) {
+    ResourceOf(heap_.tag)->deallocate(string_, heap_.capacity + 1, 1);
+  }
+}
+void String::GrowTo(size_t needed) {
+  size_t capacity = Capacity();
+  if (needed <= capacity) {
+    return;
   }
+  switch (Growth()) {
+    case GrowthPolicy::kDouble:
+      needed = std::max(needed, 2 * capacity);
+      break;
+    case GrowthPolicy::kOneAndHalf:
+      needed = std::max(needed, capacity + capacity / 2);
+      break;
+    case GrowthPolicy::kExact:
+      break;
+  }
+  Reallocate(needed);
+}
+void String::SetGrowth(GrowthPolicy policy) {
+  Retag(MakeTag(Resource(), policy));
+}
+// Changes the tag of an inline string, moving the characters to the other
+// inline layout or, when they do not fit there, to the heap with the same
+// capacity as before.
+void String::Retag(uintptr_t tag) {
+  if (IsHeap()) {
+    heap_.tag = tag;
+    return;
+  }
+  if (tag == Tag()) {
+    return;
+  }
+  char saved[kLocalSize];
+  memcpy(saved, string_, size_);
+  if (size_ <= LocalCapacity(tag)) {
+    SetLocal(tag);
+    memcpy(string_, saved, size_);
+  } else {
+    size_t capacity = Capacity();
+    char* buffer =
+        static_cast<char*>(ResourceOf(tag)->allocate(capacity + 1, 1));
+    memcpy(buffer, saved, size_);
+    heap_.tag = tag;
+    heap_.capacity = capacity;
+    string_ = buffer;
+  }
+  Zero();
+}
+
+String::String(std::pmr::memory_resource* resource, GrowthPolicy policy) {
+  SetLocal(MakeTag(resource, policy));
+  Zero();
+}
+String::String(StringView view, std::pmr::memory_resource* resource) {
+  SetLocal(MakeTag(resource, GrowthPolicy::kDouble));
+  Init(view.Size());
+  memcpy(string_, view.Data(), size_);
   Zero();
 }
-String::String(const char* cstr) : size_(strlen(cstr)), capacity_(size_) {
-  string_ = new char[size_ + 1];
+String::String(const String& other, std::pmr::memory_resource* resource)
+    : String(StringView(other), resource) {}
+
+String::String(size_t size, char letter) {
+  SetLocal(DefaultTag());
+  Init(size);
+  memset(string_, letter, size_);
+  Zero();
+}
+String::String(const char* cstr) {
+  SetLocal(DefaultTag());
+  Init(strlen(cstr));
   memcpy(string_, cstr, size_);
   Zero();
 }
-String::String(const String& other) {
-  size_ = strlen(other.string_);
-  capacity_ = size_;
-  string_ = new char[size_ + 1];
-  for (int i = 0; i < size_; i++) {
-    string_[i] = other.string_[i];
+// Takes other's characters and tag (a plain copy of the 16 bytes either
+// way) and leaves other empty with its tag; any buffer of *this must be
+// released.
+void String::StealFrom(String& other) noexcept {
+  size_ = other.size_;
+  memcpy(local_, other.local_, kLocalSize);
+  if (other.IsHeap()) {
+    string_ = other.string_;
+    other.SetLocal(heap_.tag);
+  } else {
+    string_ = local_ + (other.string_ - other.local_);
   }
+  other.size_ = 0;
+  other.Zero();
+}
+
+String::String(StringView view) {
+  SetLocal(DefaultTag());
+  Init(view.Size());
+  memcpy(string_, view.Data(), size_);
+  Zero();
+}
+String::String(const String& other) {
+  SetLocal(DefaultTag());
+  Init(other.size_);
+  memcpy(string_, other.string_, size_);
   Zero();
 }
+String::String(String&& other) noexcept { StealFrom(other); }
+// Reuses the current buffer whenever it is large enough. A new buffer is
+// allocated before the old one is released, so a throwing resource leaves
+// *this unchanged.
 String& String::operator=(const String& other) {
   if (this == &other) {
     return *this;
   }
-  size_ = other.size_;
-  capacity_ = other.capacity_;
-  delete[] string_;
-  string_ = new char[capacity_ + 1];
-  if (other.string_ != nullptr) {
-    memcpy(string_, other.string_, size_);
+  if (other.size_ > Capacity()) {
+    uintptr_t tag = Tag();
+    char* buffer =
+        static_cast<char*>(ResourceOf(tag)->allocate(other.size_ + 1, 1));
+    Release();
+    heap_.tag = tag;
+    heap_.capacity = other.size_;
+    string_ = buffer;
   }
+  size_ = other.size_;
+  memcpy(string_, other.string_, size_);
   Zero();
   return *this;
 }
+String& String::operator=(String&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  Release();
+  StealFrom(other);
+  return *this;
+}
 
 size_t String::Size() const { return size_; }
-size_t String::Capacity() const { return capacity_; }
+size_t String::Capacity() const {
+  if (string_ == local_) {
+    return kLocalSize - 1;
+  }
+  return string_ == local_ + 8 ? kLocalSize - 8 - 1 : heap_.capacity;
+}
 bool String::Empty() const { return (size_ == 0); }
 void String::Clear() {
-  if (!(this->Empty())) {
-    size_ = 0;
-    string_[0] = '\0';
-  }
+  size_ = 0;
+  Zero();
 }
 void String::PushBack(const char& character) {
-  if (size_ == capacity_) {
-    Reserve(2 * size_ + 1);
-  }
+  GrowTo(size_ + 1);
   string_[size_] = character;
   ++size_;
   Zero();
@@ -64,48 +215,37 @@ void String::PopBack() {
     Zero();
   }
 }
-void String::Resize(int new_size) {
-  if (new_size > capacity_) {
-    char* new_str = new char[new_size + 1];
-    for (int i = 0; i < size_; i++) {
-      new_str[i] = string_[i];
-    }
-    delete[] string_;
-    string_ = new_str;
+void String::Resize(size_t new_size) {
+  if (new_size > Capacity()) {
+    Reallocate(new_size);
   }
   size_ = new_size;
   Zero();
 }
-void String::Resize(int new_size, char character) {
-  int size = size_;
+void String::Resize(size_t new_size, char character) {
+  size_t size = size_;
   Resize(new_size);
   if (size < new_size) {
     memset(string_ + size, character, new_size - size);
   }
-  string_[new_size] = '\0';
 }
-void String::Reserve(int new_cap) {
-  if (new_cap > capacity_) {
-    char* copy_string = new char[new_cap + 1];
-    if (string_ != nullptr) {
-      memcpy(copy_string, string_, size_);
-      delete[] string_;
-    }
-    capacity_ = new_cap;
-    string_ = copy_string;
-    Zero();
+void String::Reserve(size_t new_cap) {
+  if (new_cap > Capacity()) {
+    Reallocate(new_cap);
   }
 }
 void String::ShrinkToFit() {
-  if (capacity_ > size_) {
-    capacity_ = size_;
+  if (IsHeap() && heap_.capacity > size_) {
+    Reallocate(size_);
   }
 }
 void String::Swap(String& other) {
-  char* ttt;
-  ttt = other.string_;
-  other.string_ = string_;
-  string_ = ttt;
+  if (this == &other) {
+    return;
+  }
+  String temp(std::move(other));
+  other.StealFrom(*this);
+  StealFrom(temp);
 }
 char& String::operator[](size_t iii) { return string_[iii]; }
 const char& String::operator[](size_t iii) const { return string_[iii]; }
@@ -114,112 +254,410 @@ char& String::Back() { return this->string_[size_ - 1]; }
 char String::Front() const { return this->string_[0]; }
 char String::Back() const { return this->string_[size_ - 1]; }
 const char* String::Data() const { return string_; }
-char* String::Data() { return string_; }
-bool String::operator<(String other) const {
-  if ((string_ == nullptr) || (other.string_ == nullptr)) {
-    return false;
-  }
-  if (this->size_ < other.size_) {
-    return true;
-  }
-  for (int i = 0; i < size_; i++) {
-    if (string_[i] != other.string_[i]) {
-      return string_[i] < other.string_[i];
-    }
-  }
-  return false;
+char* String::MutableData() { return string_; }
+bool String::operator<(const String& other) const {
+  return Compare(other) < 0;
+}
+bool String::operator>(const String& other) const {
+  return Compare(other) > 0;
+}
+bool String::operator<=(const String& other) const {
+  return Compare(other) <= 0;
+}
+bool String::operator>=(const String& other) const {
+  return Compare(other) >= 0;
 }
-bool String::operator>(String other) const { return (other < *this); }
-bool String::operator<=(String other) const { return !(*this > other); }
-bool String::operator>=(String other) const { return !(*this < other); }
 bool String::operator==(const String& other) const {
-  return (!(*this < other) && !(*this > other));
+  return size_ == other.size_ && memcmp(string_, other.string_, size_) == 0;
 }
-bool String::operator!=(String other) const {
-  return !(this->string_ == other.string_);
+bool String::operator!=(const String& other) const {
+  return !(*this == other);
 }
 char& String::operator[](int index) { return this->string_[index]; }
 const char& String::operator[](int index) const { return this->string_[index]; }
 
 String& String::operator+=(const String& other) {
-  if (capacity_ < size_ + other.size_) {
-    Reserve(2 * (size_ + other.size_));
-  }
-  if (string_ != nullptr) {
-    memcpy(string_ + size_, other.string_, other.size_);
-    size_ += other.size_;
-    Zero();
-  }
+  GrowTo(size_ + other.size_);
+  memcpy(string_ + size_, other.string_, other.size_);
+  size_ += other.size_;
+  Zero();
   return *this;
 }
 String operator+(const String& first_string, const String& second_string) {
-  String result = "";
-  result += first_string;
-  result += second_string;
-  return result;
+  return String::Concat({first_string, second_string});
 }
-String operator*(const String& string, int n) {
-  String result = string;
-  result *= n;
-  return result;
+size_t String::RepeatedSize(size_t size, size_t n) {
+  // One byte is kept for the terminating zero.
+  if (n != 0 && size > (std::numeric_limits<size_t>::max() - 1) / n) {
+    throw std::length_error("String: repeated size overflows");
+  }
+  return size * n;
+}
+// Writes pattern repeated over out[0, size): the first copy, then
+// doubling memcpys of what is already there. Single characters use memset.
+void String::FillPattern(char* out, size_t size, StringView pattern) {
+  if (size == 0) {
+    return;
+  }
+  if (pattern.Empty()) {
+    throw std::invalid_argument("String: empty fill pattern");
+  }
+  if (pattern.Size() == 1) {
+    memset(out, pattern[0], size);
+    return;
+  }
+  size_t filled = std::min(pattern.Size(), size);
+  memcpy(out, pattern.Data(), filled);
+  while (filled < size) {
+    size_t chunk = std::min(filled, size - filled);
+    memcpy(out + filled, out, chunk);
+    filled += chunk;
+  }
+}
+
+bool String::Overlaps(StringView view) const {
+  uintptr_t begin = reinterpret_cast<uintptr_t>(string_);
+  uintptr_t at = reinterpret_cast<uintptr_t>(view.Data());
+  return at >= begin && at <= begin + Capacity();
 }
 
+String operator*(const String& string, int n) {
+  if (n < 0) {
+    throw std::invalid_argument("String::operator*: negative count");
+  }
+  return string.Repeat(static_cast<size_t>(n));
+}
 String& String::operator*=(int n) {
-  if (capacity_ <= n * size_) {
-    Reserve(2 * n * size_ + 1);
+  if (n < 0) {
+    throw std::invalid_argument("String::operator*=: negative count");
   }
-  for (int i = 0; i < n * size_; i++) {
-    string_[i] = string_[i % size_];
+  size_t new_size = RepeatedSize(size_, static_cast<size_t>(n));
+  if (new_size > size_) {
+    GrowTo(new_size);
+    FillPattern(string_ + size_, new_size - size_, *this);
   }
-  size_ *= n;
-  if (string_ != nullptr) {
-    Zero();
+  size_ = new_size;
+  Zero();
+  return *this;
+}
+String String::Repeat(size_t n) const {
+  String result;
+  result.Init(RepeatedSize(size_, n));
+  FillPattern(result.string_, result.size_, *this);
+  result.Zero();
+  return result;
+}
+String& String::PadLeft(size_t width, StringView fill) {
+  if (width <= size_) {
+    return *this;
+  }
+  if (fill.Empty()) {
+    throw std::invalid_argument("String::PadLeft: empty fill pattern");
+  }
+  if (Overlaps(fill)) {
+    String copy(fill);
+    return PadLeft(width, copy);
+  }
+  size_t pad = width - size_;
+  GrowTo(width);
+  memmove(string_ + pad, string_, size_);
+  FillPattern(string_, pad, fill);
+  size_ = width;
+  Zero();
+  return *this;
+}
+String& String::PadRight(size_t width, StringView fill) {
+  if (width <= size_) {
+    return *this;
+  }
+  if (fill.Empty()) {
+    throw std::invalid_argument("String::PadRight: empty fill pattern");
+  }
+  if (Overlaps(fill)) {
+    String copy(fill);
+    return PadRight(width, copy);
+  }
+  GrowTo(width);
+  FillPattern(string_ + size_, width - size_, fill);
+  size_ = width;
+  Zero();
+  return *this;
+}
+String& String::Fill(StringView fill) {
+  if (fill.Empty()) {
+    throw std::invalid_argument("String::Fill: empty fill pattern");
+  }
+  if (Overlaps(fill)) {
+    String copy(fill);
+    return Fill(copy);
+  }
+  FillPattern(string_, size_, fill);
+  return *this;
+}
+void String::CheckParsed(std::from_chars_result result, const char* end,
+                         const char* what) {
+  if (result.ec == std::errc::result_out_of_range) {
+    throw std::out_of_range(std::string(what) + ": value out of range");
+  }
+  if (result.ec != std::errc() || result.ptr != end) {
+    throw std::invalid_argument(std::string(what) + ": not a number");
   }
+}
+String& String::AppendDouble(double value) {
+  // "-2.2250738585072014e-308" is the longest shortest form.
+  const size_t kMaxChars = 24;
+  GrowTo(size_ + kMaxChars);
+  char* end =
+      std::to_chars(string_ + size_, string_ + size_ + kMaxChars, value).ptr;
+  size_ = end - string_;
+  Zero();
   return *this;
 }
+double String::ParseDouble() const {
+  double value = 0;
+  CheckParsed(std::from_chars(string_, string_ + size_, value),
+              string_ + size_, "String::ParseDouble");
+  return value;
+}
+
 std::istream& operator>>(std::istream& iis, String& other) {
-  other.Clear();
-  char character;
-  while ((iis.get(character)) && !(iis.eof())) {
-    other.PushBack(character);
+  return ReadAll(iis, other);
+}
+std::istream& ReadAll(std::istream& iis, String& out) {
+  const size_t kChunk = 1 << 16;
+  out.Clear();
+  std::istream::sentry sentry(iis, true);
+  if (!sentry) {
+    return iis;
+  }
+  std::streambuf* buf = iis.rdbuf();
+  for (;;) {
+    out.GrowTo(out.size_ + kChunk);
+    size_t room = out.Capacity() - out.size_;
+    std::streamsize got =
+        buf->sgetn(out.string_ + out.size_, static_cast<std::streamsize>(room));
+    out.size_ += static_cast<size_t>(got);
+    if (static_cast<size_t>(got) < room) {
+      break;
+    }
+  }
+  out.Zero();
+  iis.setstate(out.Empty() ? std::ios::eofbit | std::ios::failbit
+                           : std::ios::eofbit);
+  return iis;
+}
+// istream::getline scans the stream's buffer for delim a block at a time
+// (memchr in libstdc++) and copies straight into the String's buffer; a
+// line longer than the room left is continued after growing it.
+std::istream& ReadLine(std::istream& iis, String& line, char delim) {
+  const size_t kChunk = 256;
+  line.Clear();
+  std::istream::sentry sentry(iis, true);
+  if (!sentry) {
+    return iis;
+  }
+  bool extracted = false;
+  for (;;) {
+    if (line.size_ == line.Capacity()) {
+      line.GrowTo(line.size_ + kChunk);
+    }
+    // getline stores at most room characters plus a terminating zero,
+    // which the buffer's extra byte holds.
+    size_t room = line.Capacity() - line.size_;
+    iis.getline(line.string_ + line.size_,
+                static_cast<std::streamsize>(room + 1), delim);
+    size_t got = static_cast<size_t>(iis.gcount());
+    extracted = extracted || got > 0;
+    if (iis.bad() || iis.eof()) {
+      line.size_ += got;
+      break;
+    }
+    if (iis.fail() && got == room) {
+      // Filled the buffer before reaching delim.
+      line.size_ += got;
+      iis.clear(iis.rdstate() & ~std::ios::failbit);
+      continue;
+    }
+    // delim was extracted and counted, but not stored.
+    line.size_ += got - 1;
+    break;
+  }
+  line.Zero();
+  iis.clear(iis.rdstate() & ~std::ios::failbit);
+  if (!extracted) {
+    iis.setstate(std::ios::failbit);
   }
   return iis;
 }
+
+namespace {
+
+// Closes a file descriptor when it goes out of scope.
+struct FdCloser {
+  int fd;
+  ~FdCloser() { close(fd); }
+};
+
+}  // namespace
+
+String String::FromFile(const char* path) {
+  const size_t kChunk = 1 << 16;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "String::FromFile: open");
+  }
+  FdCloser closer{fd};
+  String result;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    result.Reserve(static_cast<size_t>(info.st_size));
+  }
+  char spill[kChunk];
+  for (;;) {
+    // Once the fstat-sized buffer is full, probe through a stack chunk so a
+    // regular file does not double its buffer just to read end-of-file.
+    bool full = result.size_ == result.Capacity();
+    char* target = full ? spill : result.string_ + result.size_;
+    size_t room = full ? kChunk : result.Capacity() - result.size_;
+    ssize_t got = read(fd, target, room);
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "String::FromFile: read");
+    }
+    if (got == 0) {
+      break;
+    }
+    if (full) {
+      result.GrowTo(result.size_ + got);
+      memcpy(result.string_ + result.size_, spill, got);
+    }
+    result.size_ += static_cast<size_t>(got);
+  }
+  result.Zero();
+  return result;
+}
 std::ostream& operator<<(std::ostream& oos, const String& other) {
   oos << other.string_;
   return oos;
 }
-std::vector<String> String::Split(const String& delim) {
-  std::vector<String> result;
-  String part = "";
-  int counter = 0;
-  for (counter = 0; counter < size_ - delim.size_ + 1; counter++) {
-    if (memcmp(string_ + counter, delim.string_, delim.size_) == 0) {
-      result.push_back(part);
-      part.Clear();
-      counter += delim.size_ - 1;
-    } else {
-      part.PushBack(string_[counter]);
-    }
+const size_t StringView::kNpos;
+
+size_t StringView::Find(StringView needle, size_t pos) const {
+  if (pos > size_) {
+    return kNpos;
   }
-  for (int i = counter; i < size_; i++) {
-    part.PushBack(string_[i]);
+  size_t found = string_search::Find(data_ + pos, size_ - pos, needle.data_,
+                                     needle.size_);
+  return found == kNpos ? kNpos : pos + found;
+}
+size_t StringView::RFind(StringView needle, size_t pos) const {
+  if (needle.size_ > size_) {
+    return kNpos;
+  }
+  size_t limit = pos < size_ - needle.size_ ? pos : size_ - needle.size_;
+  return string_search::RFind(data_, limit + needle.size_, needle.data_,
+                              needle.size_);
+}
+size_t StringView::FindFirstOf(StringView set, size_t pos) const {
+  if (pos >= size_) {
+    return kNpos;
+  }
+  size_t found = string_search::FindFirstOf(data_ + pos, size_ - pos,
+                                            set.data_, set.size_);
+  return found == kNpos ? kNpos : pos + found;
+}
+std::ostream& operator<<(std::ostream& oos, StringView view) {
+  oos.write(view.data_, view.size_);
+  return oos;
+}
+
+SplitRange::Iterator::Iterator(StringView source, StringView delim)
+    : source_(source), delim_(delim), done_(false) {
+  FindEnd();
+}
+// An empty delimiter never matches, so the whole source is one piece.
+void SplitRange::Iterator::FindEnd() {
+  end_ = delim_.Empty() ? StringView::kNpos : source_.Find(delim_, begin_);
+  if (end_ == StringView::kNpos) {
+    end_ = source_.Size();
+    last_ = true;
+  }
+}
+SplitRange::Iterator& SplitRange::Iterator::operator++() {
+  if (last_) {
+    done_ = true;
+  } else {
+    begin_ = end_ + delim_.Size();
+    FindEnd();
+  }
+  return *this;
+}
+
+size_t String::Find(StringView needle, size_t pos) const {
+  return StringView(*this).Find(needle, pos);
+}
+size_t String::RFind(StringView needle, size_t pos) const {
+  return StringView(*this).RFind(needle, pos);
+}
+size_t String::FindFirstOf(StringView set, size_t pos) const {
+  return StringView(*this).FindFirstOf(set, pos);
+}
+
+std::vector<String> String::Split(const String& delim) const {
+  std::vector<String> result;
+  for (StringView piece : SplitLazy(delim)) {
+    result.emplace_back(piece);
   }
-  result.push_back(part);
   return result;
 }
+SplitRange String::SplitLazy(StringView delim) const {
+  return SplitRange(*this, delim);
+}
+void String::SplitInto(std::vector<StringView>& out, StringView delim) const {
+  out.clear();
+  for (StringView piece : SplitLazy(delim)) {
+    out.push_back(piece);
+  }
+}
 String String::Join(const std::vector<String>& str) const {
-  String res("");
-  if (!str.empty()) {
-    for (size_t i = 0; i < str.size(); i++) {
-      res += str[i];
-      res += *this;
+  String result;
+  if (str.empty()) {
+    return result;
+  }
+  size_t total = size_ * (str.size() - 1);
+  for (const String& part : str) {
+    total += part.size_;
+  }
+  result.Init(total);
+  char* out = result.string_;
+  for (size_t i = 0; i < str.size(); i++) {
+    if (i > 0) {
+      memcpy(out, string_, size_);
+      out += size_;
     }
-    res.size_ -= this->size_;
+    memcpy(out, str[i].string_, str[i].size_);
+    out += str[i].size_;
   }
-  if (res.size_ != 0) {
-    res.string_[res.size_] = '\0';
+  result.Zero();
+  return result;
+}
+String String::Concat(std::initializer_list<StringView> parts) {
+  size_t total = 0;
+  for (StringView part : parts) {
+    total += part.Size();
   }
-  return res;
+  String result;
+  result.Init(total);
+  char* out = result.string_;
+  for (StringView part : parts) {
+    memcpy(out, part.Data(), part.Size());
+    out += part.Size();
+  }
+  result.Zero();
+  return result;
 }
 void String::Zero() { string_[size_] = '\0'; }
@@ -1,29 +1,238 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <initializer_list>
 #include <iostream>
+#include <memory_resource>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <type_traits>
 #include <vector>
 
+#include "hash.hpp"
+#include "utf8.hpp"
+
+// Non-owning reference to size_ characters at data_. Whatever it views
+// must outlive it; it never allocates.
+class StringView {
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+ public:
+  static const size_t kNpos = static_cast<size_t>(-1);
+
+  StringView() = default;
+  StringView(const char* data, size_t size) : data_(data), size_(size) {}
+  StringView(const char* cstr) : data_(cstr), size_(strlen(cstr)) {}
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  const char* Data() const { return data_; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  char operator[](size_t iii) const { return data_[iii]; }
+  // Throws std::out_of_range when pos > Size().
+  StringView Substr(size_t pos, size_t count = kNpos) const {
+    if (pos > size_) {
+      throw std::out_of_range("StringView::Substr: position past the end");
+    }
+    return {data_ + pos, count < size_ - pos ? count : size_ - pos};
+  }
+  // Position of the first occurrence of needle at or after pos, or kNpos.
+  size_t Find(StringView needle, size_t pos = 0) const;
+  // Position of the last occurrence of needle starting at or before pos.
+  size_t RFind(StringView needle, size_t pos = kNpos) const;
+  // Position of the first character at or after pos that is in set.
+  size_t FindFirstOf(StringView set, size_t pos = 0) const;
+  // Lexicographic three-way compare of unsigned bytes: negative, zero or
+  // positive as *this is less than, equal to or greater than other.
+  int Compare(StringView other) const {
+    size_t common = size_ < other.size_ ? size_ : other.size_;
+    int result = common == 0 ? 0 : memcmp(data_, other.data_, common);
+    if (result != 0) {
+      return result;
+    }
+    return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+  }
+  bool operator==(StringView other) const {
+    return size_ == other.size_ &&
+           (size_ == 0 || memcmp(data_, other.data_, size_) == 0);
+  }
+  bool operator!=(StringView other) const { return !(*this == other); }
+  friend std::ostream& operator<<(std::ostream& oos, StringView view);
+};
+
+// Lazy Split: iterating yields the pieces of source between occurrences of
+// delim as views into source, with the same pieces String::Split returns.
+// The characters of source and delim must outlive the iterators; the range
+// itself need not, as iterators hold their own copies of both views.
+class SplitRange {
+ private:
+  StringView source_;
+  StringView delim_;
+
+ public:
+  class Iterator {
+   private:
+    StringView source_;
+    StringView delim_;
+    size_t begin_ = 0;
+    size_t end_ = 0;  // Where the delimiter after this piece starts.
+    bool last_ = false;  // No delimiter follows this piece.
+    bool done_ = true;
+
+    void FindEnd();
+
+   public:
+    Iterator() = default;
+    Iterator(StringView source, StringView delim);
+    StringView operator*() const {
+      return {source_.Data() + begin_, end_ - begin_};
+    }
+    Iterator& operator++();
+    bool operator==(const Iterator& other) const {
+      return done_ == other.done_ && (done_ || begin_ == other.begin_);
+    }
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+  };
+
+  SplitRange(StringView source, StringView delim)
+      : source_(source), delim_(delim) {}
+  Iterator begin() const { return Iterator(source_, delim_); }
+  Iterator end() const { return Iterator(); }
+};
+
+// How a String picks its new capacity when an append outgrows the buffer.
+enum class GrowthPolicy {
+  kDouble,      // max(needed, 2 * capacity): fewest reallocations.
+  kOneAndHalf,  // max(needed, capacity + capacity / 2): less slack.
+  kExact,       // needed: no slack, for strings built once.
+};
+
+// Heap buffers come from a std::pmr::memory_resource, by default
+// std::pmr::get_default_resource(). Pass e.g. a monotonic_buffer_resource
+// to build a request's strings in one arena and free them all at once;
+// such strings must not outlive their resource. Copies are made with the
+// default resource (as std::pmr containers do) unless one is given; moves,
+// move assignment and Swap carry the resource along with the buffer.
 class String {
  private:
-  int size_ = 0;
-  int capacity_ = 0;
-  char* string_ = nullptr;
+  // The resource pointer with the GrowthPolicy in its low bits, which are
+  // always zero in the (polymorphic, so at least pointer-aligned)
+  // resource's address.
+  static const uintptr_t kPolicyMask = 3;
+  static const size_t kLocalSize = 16;
+
+  struct Heap {
+    uintptr_t tag;
+    size_t capacity;
+  };
+
+  // 32 bytes on 64-bit targets, in one of three layouts told apart by
+  // string_:
+  //  - string_ == local_: up to 15 characters in local_; the tag is
+  //    implied to be CompactTag(), new/delete with kDouble, the common
+  //    case.
+  //  - string_ == local_ + 8: any other tag in heap_.tag and up to 7
+  //    characters after it.
+  //  - otherwise a heap buffer of heap_.capacity + 1 bytes.
+  char* string_ = local_;
+  size_t size_ = 0;
+  union {
+    char local_[kLocalSize];
+    Heap heap_;
+  };
+
+  static uintptr_t MakeTag(std::pmr::memory_resource* resource,
+                           GrowthPolicy policy) {
+    return reinterpret_cast<uintptr_t>(resource) |
+           static_cast<uintptr_t>(policy);
+  }
+  static uintptr_t CompactTag() {
+    static const uintptr_t tag =
+        MakeTag(std::pmr::new_delete_resource(), GrowthPolicy::kDouble);
+    return tag;
+  }
+  static uintptr_t DefaultTag() {
+    return MakeTag(std::pmr::get_default_resource(), GrowthPolicy::kDouble);
+  }
+  static std::pmr::memory_resource* ResourceOf(uintptr_t tag) {
+    return reinterpret_cast<std::pmr::memory_resource*>(tag & ~kPolicyMask);
+  }
+  static size_t LocalCapacity(uintptr_t tag) {
+    return tag == CompactTag() ? kLocalSize - 1 : kLocalSize - 8 - 1;
+  }
+  bool IsHeap() const {
+    return string_ != local_ && string_ != local_ + 8;
+  }
+  uintptr_t Tag() const {
+    return string_ == local_ ? CompactTag() : heap_.tag;
+  }
+  // Switches to the inline layout for `tag`; the characters are left to
+  // the caller.
+  void SetLocal(uintptr_t tag) {
+    if (tag == CompactTag()) {
+      string_ = local_;
+    } else {
+      heap_.tag = tag;
+      string_ = local_ + 8;
+    }
+  }
+  void Retag(uintptr_t tag);
+  void Init(size_t size);
+  void Reallocate(size_t new_cap);
+  void Release();
+  // Reallocates, as the growth policy says, when more than Capacity()
+  // characters are needed.
+  void GrowTo(size_t needed);
+  void StealFrom(String& other) noexcept;
+  static size_t RepeatedSize(size_t size, size_t n);
+  // Throws std::invalid_argument unless from_chars succeeded and consumed
+  // every character, std::out_of_range when the value did not fit.
+  static void CheckParsed(std::from_chars_result result, const char* end,
+                          const char* what);
+  static void FillPattern(char* out, size_t size, StringView pattern);
+  // Whether view points into this string's buffer, where growing or
+  // writing in place would clobber it.
+  bool Overlaps(StringView view) const;
 
  public:
-  String() = default;
-  String(int size, char letter);
+  String() {
+    SetLocal(DefaultTag());
+    string_[0] = '\0';
+  }
+  explicit String(std::pmr::memory_resource* resource,
+                  GrowthPolicy policy = GrowthPolicy::kDouble);
+  String(StringView view, std::pmr::memory_resource* resource);
+  String(const String& other, std::pmr::memory_resource* resource);
+  String(size_t size, char letter);
   String(const char* cstr);
+  explicit String(StringView view);
   String(const String& other);
-  ~String() { delete[] string_; };
+  String(String&& other) noexcept;
+  ~String() { Release(); }
+  std::pmr::memory_resource* Resource() const { return ResourceOf(Tag()); }
+  GrowthPolicy Growth() const {
+    return static_cast<GrowthPolicy>(Tag() & kPolicyMask);
+  }
+  // May move a short string to the heap: only the default resource with
+  // kDouble gets the full 15 inline characters.
+  void SetGrowth(GrowthPolicy policy);
   size_t Size() const;
   size_t Capacity() const;
   void Clear();
   bool Empty() const;
   void PushBack(const char& character);
   void PopBack();
-  void Resize(int new_size);
-  void Resize(int new_size, char character);
-  void Reserve(int new_cap);
+  void Resize(size_t new_size);
+  void Resize(size_t new_size, char character);
+  void Reserve(size_t new_cap);
+  // Moves the characters into a buffer of exactly Size() (or back inline)
+  // and returns the old one to the resource.
   void ShrinkToFit();
   void Swap(String& other);
   char& operator[](size_t iii);
@@ -32,25 +241,140 @@ class String {
   char& Back();
   char Front() const;
   char Back() const;
+  // Data() is const char* even on a mutable String, as the Data.NonConst
+  // test requires; MutableData() is the writable pointer, valid for
+  // Size() characters until the next reallocation.
   const char* Data() const;
-  char* Data();
-  bool operator<(String other) const;
-  bool operator>(String other) const;
-  bool operator<=(String other) const;
-  bool operator>=(String other) const;
+  char* MutableData();
+  // All comparisons go through one memcmp-based Compare.
+  int Compare(StringView other) const {
+    return StringView(string_, size_).Compare(other);
+  }
+  bool operator<(const String& other) const;
+  bool operator>(const String& other) const;
+  bool operator<=(const String& other) const;
+  bool operator>=(const String& other) const;
   bool operator==(const String& other) const;
-  bool operator!=(String other) const;
+  bool operator!=(const String& other) const;
   char& operator[](int index);
   const char& operator[](int index) const;
   String& operator+=(const String& other);
   friend String operator+(const String& first_string,
                           const String& second_string);
   String& operator=(const String& other);
+  String& operator=(String&& other) noexcept;
+  // n copies of the string. The size is computed once, checked for
+  // overflow (std::length_error; negative n throws std::invalid_argument),
+  // and the buffer is filled by copying the already written prefix, so
+  // each doubling is one memcpy.
   friend String operator*(const String& string, int n);
   String& operator*=(int n);
+  String Repeat(size_t n) const;
+  // Pad to at least `width` characters with `fill` repeated and cut to
+  // length; longer strings are left alone. Fill overwrites every
+  // character. An empty `fill` throws std::invalid_argument; it may view
+  // this string itself.
+  String& PadLeft(size_t width, StringView fill = " ");
+  String& PadRight(size_t width, StringView fill = " ");
+  String& Fill(StringView fill);
+  // Reads everything up to the end of the stream.
   friend std::istream& operator>>(std::istream& iis, String& other);
+  // Replaces `out` with the rest of the stream, read in large chunks straight
+  // into its buffer.
+  friend std::istream& ReadAll(std::istream& iis, String& out);
+  // Like std::getline: reads up to and discards `delim`; fails only when
+  // nothing at all could be read.
+  friend std::istream& ReadLine(std::istream& iis, String& line,
+                                char delim);
+  // Whole file with one read of its fstat size (plus chunked reads for
+  // files that report no size, such as /proc entries). Throws
+  // std::system_error on failure.
+  static String FromFile(const char* path);
   friend std::ostream& operator<<(std::ostream& oos, const String& other);
-  std::vector<String> Split(const String& delim = " ");
+  operator StringView() const { return {string_, size_}; }
+  size_t Find(StringView needle, size_t pos = 0) const;
+  size_t RFind(StringView needle, size_t pos = StringView::kNpos) const;
+  size_t FindFirstOf(StringView set, size_t pos = 0) const;
+  std::vector<String> Split(const String& delim = " ") const;
+  // Allocation-free variants; the results view *this and must not outlive
+  // it. SplitInto clears `out` and refills it, so reusing one vector across
+  // calls keeps its capacity.
+  SplitRange SplitLazy(StringView delim = " ") const;
+  void SplitInto(std::vector<StringView>& out, StringView delim = " ") const;
+  // Both size the result first and copy every part once into a single
+  // allocation.
   String Join(const std::vector<String>& str) const;
+  // Append the decimal form of value, formatted with std::to_chars straight
+  // into the buffer: no temporaries, no locale. Doubles use the shortest
+  // representation that parses back to the same value.
+  template <typename Int, typename = std::enable_if_t<std::is_integral_v<Int>>>
+  String& AppendInt(Int value) {
+    // Sign plus the digits of the widest 64-bit value.
+    const size_t kMaxChars = 21;
+    GrowTo(size_ + kMaxChars);
+    char* end = std::to_chars(string_ + size_, string_ + size_ + kMaxChars,
+                              value).ptr;
+    size_ = end - string_;
+    Zero();
+    return *this;
+  }
+  String& AppendDouble(double value);
+  // The whole string as a number in the same format (no leading '+' or
+  // whitespace); see CheckParsed for the errors. Some standard libraries
+  // (libstdc++ 11) report subnormal doubles as out of range.
+  template <typename Int = int64_t,
+            typename = std::enable_if_t<std::is_integral_v<Int>>>
+  Int ParseInt() const {
+    Int value = 0;
+    CheckParsed(std::from_chars(string_, string_ + size_, value),
+                string_ + size_, "String::ParseInt");
+    return value;
+  }
+  double ParseDouble() const;
+  // UTF-8 helpers; see utf8.hpp. The case mappings touch ASCII letters
+  // only and so keep valid UTF-8 valid.
+  bool IsValidUtf8() const { return utf8::Validate(string_, size_); }
+  size_t CodePointCount() const {
+    return utf8::CountCodePoints(string_, size_);
+  }
+  utf8::CodePointRange CodePoints() const { return {string_, size_}; }
+  String& ToLowerAscii() {
+    utf8::ToLowerAscii(string_, size_);
+    return *this;
+  }
+  String& ToUpperAscii() {
+    utf8::ToUpperAscii(string_, size_);
+    return *this;
+  }
+  static String Concat(std::initializer_list<StringView> parts);
   void Zero();
 };
+
+std::istream& ReadLine(std::istream& iis, String& line, char delim = '\n');
+
+// Concat(a, b, c, ...) for any mix of Strings, StringViews and C strings,
+// with one allocation.
+template <typename... Parts>
+String Concat(const Parts&... parts) {
+  return String::Concat({StringView(parts)...});
+}
+
+namespace std {
+
+template <>
+struct hash<StringView> {
+  size_t operator()(StringView view) const noexcept {
+    return string_hash::Hash(view.Data(), view.Size());
+  }
+};
+
+// Equal to the hash of the corresponding StringView, so heterogeneous
+// lookup works.
+template <>
+struct hash<String> {
+  size_t operator()(const String& string) const noexcept {
+    return string_hash::Hash(string.Data(), string.Size());
+  }
+};
+
+}  // namespace std
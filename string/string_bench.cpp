@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "string.hpp"
+
+// Time and heap allocations per operation of String against std::string
+// for the common operations, over a range of string sizes. Allocations are
+// counted by replacing the global operator new, plain for std::string and
+// aligned for new_delete_resource(), String's default memory resource.
+//
+//   string_bench            full run
+//   string_bench --quick    two sizes, one repetition (used by ctest)
+
+namespace {
+
+size_t allocations = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void* operator new(size_t size, std::align_val_t align) {
+  ++allocations;
+  size_t alignment = std::max(static_cast<size_t>(align), sizeof(void*));
+  // aligned_alloc wants a multiple of the alignment.
+  size_t rounded =
+      (std::max<size_t>(size, 1) + alignment - 1) & ~(alignment - 1);
+  if (void* ptr = std::aligned_alloc(alignment, rounded)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile size_t sink;
+
+struct Cost {
+  double nanoseconds;
+  double allocations;
+};
+
+// Best time per call over `repeats` samples, each long enough for the
+// timer, and the allocations made per call.
+template <typename Fn>
+Cost Measure(size_t repeats, size_t size, Fn fn) {
+  const size_t kBytesPerSample = 1 << 24;
+  size_t inner =
+      std::max<size_t>(16, kBytesPerSample / std::max<size_t>(size, 1));
+  double best = 1e30;
+  size_t allocated = 0;
+  for (size_t rep = 0; rep < repeats; ++rep) {
+    size_t before = allocations;
+    auto start = Clock::now();
+    for (size_t iii = 0; iii < inner; ++iii) {
+      fn();
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    allocated = allocations - before;
+    best = std::min(best, elapsed.count());
+  }
+  return {best * 1e9 / inner, static_cast<double>(allocated) / inner};
+}
+
+void Report(const char* name, size_t size, Cost ours, Cost theirs) {
+  std::cout << std::left << std::setw(14) << name << std::right
+            << std::setw(8) << size << std::fixed << std::setprecision(1)
+            << std::setw(12) << ours.nanoseconds << std::setw(12)
+            << theirs.nanoseconds << std::setprecision(2) << std::setw(11)
+            << ours.allocations << std::setw(11) << theirs.allocations
+            << "\n";
+}
+
+// `size` characters of eight-letter words separated by single spaces.
+std::string Words(size_t size) {
+  std::string text;
+  for (size_t iii = 0; text.size() < size; ++iii) {
+    text.push_back(iii % 9 == 8 ? ' ' : static_cast<char>('a' + iii % 26));
+  }
+  return text;
+}
+
+void RunSize(size_t size, size_t repeats) {
+  const size_t kPiece = 16;
+  const std::string text = Words(size);
+  const String ours_text(text.c_str());
+
+  Report("PushBack", size,
+         Measure(repeats, size,
+                 [&] {
+                   String s;
+                   for (size_t iii = 0; iii < size; ++iii) {
+                     s.PushBack(static_cast<char>(iii));
+                   }
+                   sink = s.Size();
+                 }),
+         Measure(repeats, size, [&] {
+           std::string s;
+           for (size_t iii = 0; iii < size; ++iii) {
+             s.push_back(static_cast<char>(iii));
+           }
+           sink = s.size();
+         }));
+
+  const String piece(kPiece, 'p');
+  const std::string std_piece(kPiece, 'p');
+  Report("+=", size,
+         Measure(repeats, size,
+                 [&] {
+                   String s;
+                   for (size_t done = 0; done < size; done += kPiece) {
+                     s += piece;
+                   }
+                   sink = s.Size();
+                 }),
+         Measure(repeats, size, [&] {
+           std::string s;
+           for (size_t done = 0; done < size; done += kPiece) {
+             s += std_piece;
+           }
+           sink = s.size();
+         }));
+
+  Report("copy", size, Measure(repeats, size, [&] {
+           String copy(ours_text);
+           sink = copy.Size();
+         }),
+         Measure(repeats, size, [&] {
+           std::string copy(text);
+           sink = copy.size();
+         }));
+
+  // Equal up to the last character, so the whole string is compared.
+  String ours_other = ours_text;
+  ours_other[size - 1] = '~';
+  std::string other = text;
+  other[size - 1] = '~';
+  Report("compare", size, Measure(repeats, size, [&] {
+           sink = (ours_text == ours_other) + (ours_text < ours_other);
+         }),
+         Measure(repeats, size, [&] {
+           sink = (text == other) + (text < other);
+         }));
+
+  Report("Split", size, Measure(repeats, size, [&] {
+           sink = ours_text.Split(" ").size();
+         }),
+         Measure(repeats, size, [&] {
+           std::vector<std::string> parts;
+           size_t begin = 0;
+           for (;;) {
+             size_t end = text.find(' ', begin);
+             parts.push_back(text.substr(begin, end - begin));
+             if (end == std::string::npos) {
+               break;
+             }
+             begin = end + 1;
+           }
+           sink = parts.size();
+         }));
+
+  std::vector<StringView> views;
+  Report("SplitInto", size, Measure(repeats, size, [&] {
+           ours_text.SplitInto(views, " ");
+           sink = views.size();
+         }),
+         Measure(repeats, size, [&] {
+           static std::vector<std::string_view> std_views;
+           std_views.clear();
+           std::string_view rest = text;
+           for (;;) {
+             size_t end = rest.find(' ');
+             std_views.push_back(rest.substr(0, end));
+             if (end == std::string_view::npos) {
+               break;
+             }
+             rest.remove_prefix(end + 1);
+           }
+           sink = std_views.size();
+         }));
+
+  std::vector<String> ours_parts = ours_text.Split(" ");
+  std::vector<std::string> parts;
+  for (const String& part : ours_parts) {
+    parts.emplace_back(part.Data(), part.Size());
+  }
+  const String comma = ",";
+  Report("Join", size, Measure(repeats, size, [&] {
+           sink = comma.Join(ours_parts).Size();
+         }),
+         Measure(repeats, size, [&] {
+           std::string joined;
+           for (size_t iii = 0; iii < parts.size(); ++iii) {
+             if (iii > 0) {
+               joined += ',';
+             }
+             joined += parts[iii];
+           }
+           sink = joined.size();
+         }));
+
+  // The streams are rewound rather than rebuilt, so only reading is timed.
+  std::istringstream ours_stream(text);
+  std::istringstream std_stream(text);
+  Report("stream in", size, Measure(repeats, size, [&] {
+           ours_stream.clear();
+           ours_stream.seekg(0);
+           String s;
+           ours_stream >> s;
+           sink = s.Size();
+         }),
+         Measure(repeats, size, [&] {
+           std_stream.clear();
+           std_stream.seekg(0);
+           std::string s(std::istreambuf_iterator<char>(std_stream), {});
+           sink = s.size();
+         }));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool quick = argc > 1 && std::string(argv[1]) == "--quick";
+  std::vector<size_t> sizes =
+      quick ? std::vector<size_t>{8, 1024}
+            : std::vector<size_t>{8, 15, 64, 1024, 65536, 1 << 22};
+  size_t repeats = quick ? 1 : 5;
+
+  std::cout << std::left << std::setw(14) << "op" << std::right
+            << std::setw(8) << "size" << std::setw(12) << "String ns"
+            << std::setw(12) << "std ns" << std::setw(11) << "String al"
+            << std::setw(11) << "std al" << "\n";
+  for (size_t size : sizes) {
+    RunSize(size, repeats);
+  }
+  return 0;
+}
@@ -1,7 +1,21 @@
 #include "string.hpp"
+#include "rope.hpp"
+#include "interner.hpp"
 #include <gtest/gtest.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <fstream>
+#include <memory_resource>
 #include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 TEST(Constructors, Default) {
   String s;
@@ -217,6 +231,15 @@ TEST(Data, Const) {
   EXPECT_TRUE(are_same);
 }
 
+TEST(Data, Mutable) {
+  String s = "abob";
+  bool are_same = std::is_same_v<decltype(s.MutableData()), char*>;
+  EXPECT_TRUE(are_same);
+  EXPECT_EQ(s.MutableData(), s.Data());
+  s.MutableData()[1] = 'l';
+  EXPECT_TRUE(s == "alob");
+}
+
 TEST(SizeCapacity, IsUnsigned) {
   String s;
   EXPECT_TRUE(std::is_unsigned_v<decltype(s.Size())>);
@@ -422,6 +445,780 @@ TEST(Join, Stress) {
   EXPECT_TRUE(expected == b.Join({a, a}).Join({c, c}));
 }
 
+TEST(SmallString, ShortStaysInline) {
+  String s = "short token";
+  const char* begin = reinterpret_cast<const char*>(&s);
+  EXPECT_TRUE(s.Data() >= begin && s.Data() < begin + sizeof(String));
+  EXPECT_LE(sizeof(String), 32);
+  String empty;
+  EXPECT_GE(empty.Capacity(), 15);
+  EXPECT_EQ(empty.Data()[0], '\0');
+}
+
+TEST(SmallString, GrowsToHeapAndBack) {
+  String s;
+  std::string expected;
+  for (size_t i = 0; i < 100; ++i) {
+    s.PushBack('a' + i % 26);
+    expected.push_back('a' + i % 26);
+  }
+  EXPECT_TRUE(s == expected.data());
+  s.Resize(3);
+  EXPECT_TRUE(s == "abc");
+  String copy = s;
+  EXPECT_TRUE(copy == "abc");
+}
+
+TEST(SmallString, SwapMixed) {
+  String small = "tiny";
+  String large(40, 'x');
+  small.Swap(large);
+  EXPECT_TRUE(large == "tiny");
+  EXPECT_TRUE(small == String(40, 'x'));
+  large.Swap(small);
+  EXPECT_TRUE(small == "tiny");
+  EXPECT_EQ(large.Size(), 40);
+}
+
+TEST(Move, StealsHeapBuffer) {
+  String s(100, 'a');
+  const char* data = s.Data();
+  String t(std::move(s));
+  EXPECT_EQ(t.Data(), data);
+  EXPECT_EQ(t.Size(), 100);
+  EXPECT_TRUE(s.Empty());
+  String u = "short";
+  u = std::move(t);
+  EXPECT_EQ(u.Data(), data);
+  EXPECT_TRUE(t.Empty());
+  EXPECT_TRUE(std::is_nothrow_move_constructible_v<String>);
+  EXPECT_TRUE(std::is_nothrow_move_assignable_v<String>);
+}
+
+TEST(Move, VectorGrowthKeepsBuffers) {
+  std::vector<String> tokens;
+  tokens.push_back(String(64, 'x'));
+  const char* data = tokens[0].Data();
+  for (size_t i = 0; i < 100; ++i) {
+    tokens.push_back(String("tok"));
+  }
+  EXPECT_EQ(tokens[0].Data(), data);
+  EXPECT_TRUE(tokens[100] == "tok");
+}
+
+TEST(Copy, EmbeddedNul) {
+  String s(5, 'a');
+  s[2] = '\0';
+  String t(s);
+  EXPECT_EQ(t.Size(), 5);
+  EXPECT_EQ(t[4], 'a');
+  String u(40, 'b');
+  const char* data = u.Data();
+  u = s;
+  EXPECT_EQ(u.Data(), data);
+  EXPECT_EQ(u.Size(), 5);
+  EXPECT_EQ(u[3], 'a');
+}
+
+TEST(StringView, Basics) {
+  String s = "hello world";
+  StringView view = s;
+  EXPECT_EQ(view.Size(), 11);
+  EXPECT_EQ(view.Data(), s.Data());
+  EXPECT_TRUE(view.Substr(6) == "world");
+  EXPECT_TRUE(view.Substr(0, 5) == "hello");
+  EXPECT_EQ(view.Find("o"), 4);
+  EXPECT_EQ(view.Find("o", 5), 7);
+  EXPECT_EQ(view.Find("xyz"), StringView::kNpos);
+  EXPECT_TRUE(String(view.Substr(6)) == "world");
+  EXPECT_TRUE(view.Substr(11).Empty());
+  EXPECT_THROW(view.Substr(12), std::out_of_range);
+  EXPECT_THROW(StringView().Substr(1), std::out_of_range);
+}
+
+TEST(Split, LazyMatchesEager) {
+  String s = "  a  b c  def  g h ";
+  std::vector<String> eager = s.Split("  ");
+  size_t count = 0;
+  for (StringView piece : s.SplitLazy("  ")) {
+    ASSERT_LT(count, eager.size());
+    EXPECT_TRUE(piece == eager[count]);
+    EXPECT_TRUE(piece.Data() >= s.Data() && piece.Data() <= s.Data() + s.Size());
+    ++count;
+  }
+  EXPECT_EQ(count, eager.size());
+}
+
+TEST(Split, LazyIteratorOutlivesRange) {
+  String s = "x,yy,,zzz";
+  // The range returned by SplitLazy is a temporary that dies here.
+  auto it = s.SplitLazy(",").begin();
+  auto end = s.SplitLazy(",").end();
+  std::vector<String> pieces;
+  for (; it != end; ++it) {
+    pieces.emplace_back(*it);
+  }
+  EXPECT_EQ(pieces, s.Split(","));
+}
+
+TEST(Split, IntoReusesBuffer) {
+  std::vector<StringView> pieces;
+  String("a,b,,c").SplitInto(pieces, ",");
+  ASSERT_EQ(pieces.size(), 4);
+  EXPECT_TRUE(pieces[2].Empty());
+  String line = "x y";
+  line.SplitInto(pieces);
+  ASSERT_EQ(pieces.size(), 2);
+  EXPECT_TRUE(pieces[1] == "y");
+  std::vector<String> whole{"abc"};
+  EXPECT_TRUE(whole == String("abc").Split(""));
+}
+
+TEST(Find, MatchesStdString) {
+  std::mt19937 gen(7);
+  for (size_t iteration = 0; iteration < 2000; ++iteration) {
+    std::string haystack(gen() % 300, 'a');
+    std::string needle(1 + gen() % (iteration % 5 == 0 ? 60 : 6), 'a');
+    for (auto& c : haystack) {
+      c = 'a' + gen() % 2;
+    }
+    for (auto& c : needle) {
+      c = 'a' + gen() % 2;
+    }
+    String s(haystack.data());
+    ASSERT_EQ(s.Find(needle.data()), haystack.find(needle));
+    ASSERT_EQ(s.RFind(needle.data()), haystack.rfind(needle));
+    ASSERT_EQ(s.FindFirstOf("bxyz"), haystack.find_first_of("bxyz"));
+  }
+  // Long periodic needles against a run of 'a's: the cases where the byte
+  // filter alone goes quadratic and both directions must hand over to
+  // Two-Way, with and without a match planted near either end.
+  std::string run(1 << 16, 'a');
+  for (std::string needle : {std::string(1000, 'a') + "b",
+                             std::string(1000, 'a') + "ba",
+                             "ab" + std::string(1000, 'a')}) {
+    for (size_t plant : {size_t(0), size_t(1), size_t(77),
+                         run.size() - needle.size() - 3,
+                         run.size() - needle.size(), run.size()}) {
+      std::string haystack = run;
+      if (plant + needle.size() <= haystack.size()) {
+        haystack.replace(plant, needle.size(), needle);
+      }
+      String s(haystack.data());
+      ASSERT_EQ(s.Find(needle.data()), haystack.find(needle));
+      ASSERT_EQ(s.RFind(needle.data()), haystack.rfind(needle));
+    }
+  }
+}
+
+TEST(Find, Positions) {
+  String s = "abcabcabc";
+  EXPECT_EQ(s.Find("abc", 1), 3);
+  EXPECT_EQ(s.RFind("abc", 5), 3);
+  EXPECT_EQ(s.RFind("abc"), 6);
+  EXPECT_EQ(s.Find(""), 0);
+  EXPECT_EQ(s.Find("abcd"), StringView::kNpos);
+  EXPECT_EQ(s.FindFirstOf("xc", 3), 5);
+  EXPECT_EQ(s.FindFirstOf("xyz"), StringView::kNpos);
+}
+
+TEST(Rope, EditsMatchStdString) {
+  std::mt19937 gen(3);
+  Rope rope;
+  std::string expected;
+  for (size_t iteration = 0; iteration < 3000; ++iteration) {
+    std::string piece(1 + gen() % 40, 'a' + gen() % 26);
+    size_t pos = gen() % (expected.size() + 1);
+    switch (gen() % 4) {
+      case 0:
+        rope += Rope(piece.data());
+        expected += piece;
+        break;
+      case 1:
+        rope.Insert(pos, Rope(piece.data()));
+        expected.insert(pos, piece);
+        break;
+      case 2: {
+        size_t count = gen() % 30;
+        rope.Erase(pos, count);
+        expected.erase(pos, count);
+        break;
+      }
+      default: {
+        Rope sub = rope.Substr(pos, 25);
+        String flat = sub.ToString();
+        ASSERT_EQ(std::string(flat.Data(), flat.Size()), expected.substr(pos, 25));
+      }
+    }
+    ASSERT_EQ(rope.Size(), expected.size());
+  }
+  String flat = rope.ToString();
+  EXPECT_EQ(std::string(flat.Data(), flat.Size()), expected);
+  EXPECT_LE(rope.Height(), 2 * std::log2(expected.size() + 2) + 2);
+}
+
+TEST(Rope, SharesChunks) {
+  Rope big(String(1 << 20, 'x'));
+  Rope doubled = big + big;
+  EXPECT_EQ(doubled.Size(), 2 << 20);
+  size_t chunks = 0;
+  doubled.ForEachChunk([&](StringView) { ++chunks; });
+  EXPECT_EQ(chunks, 2);
+  EXPECT_EQ(doubled.Substr(100, 10).ToString(), String(10, 'x'));
+  EXPECT_THROW(big.Erase(big.Size() + 1, 1), std::out_of_range);
+}
+
+TEST(Rope, IndexOutOfRangeThrows) {
+  Rope empty;
+  EXPECT_THROW(empty[0], std::out_of_range);
+  Rope rope = Rope("abc") + Rope("def");
+  EXPECT_EQ(rope[0], 'a');
+  EXPECT_EQ(rope[5], 'f');
+  EXPECT_THROW(rope[6], std::out_of_range);
+  rope.Erase(0, rope.Size());
+  EXPECT_THROW(rope[0], std::out_of_range);
+}
+
+TEST(Concat, Variadic) {
+  String a = "ab";
+  StringView b = "cd";
+  EXPECT_TRUE(Concat(a, b, "ef", String(20, 'g')) == "abcdef" + String(20, 'g'));
+  EXPECT_TRUE(Concat().Empty());
+  String joined = String(", ").Join({"x", String(30, 'y'), ""});
+  EXPECT_EQ(joined.Size(), 1 + 2 + 30 + 2);
+  EXPECT_EQ(joined.Capacity(), joined.Size());
+}
+
+TEST(Iostream, LargeInput) {
+  std::string text(3 << 20, 'z');
+  text[12345] = '\0';
+  std::stringstream is(text);
+  String s;
+  is >> s;
+  ASSERT_EQ(s.Size(), text.size());
+  EXPECT_EQ(s[12345], '\0');
+  EXPECT_EQ(s[s.Size() - 1], 'z');
+}
+
+TEST(Iostream, ReadLine) {
+  std::stringstream is("first\n\nthird line\nlast");
+  String line;
+  std::vector<String> lines;
+  while (ReadLine(is, line)) {
+    lines.push_back(line);
+  }
+  std::vector<String> expected{"first", "", "third line", "last"};
+  EXPECT_TRUE(lines == expected);
+  std::stringstream rest("a;b");
+  ReadLine(rest, line, ';');
+  String tail;
+  ReadAll(rest, tail);
+  EXPECT_TRUE(line == "a");
+  EXPECT_TRUE(tail == "b");
+}
+
+TEST(Iostream, ReadLineLongLines) {
+  std::string text;
+  std::vector<std::string> expected;
+  for (size_t size : {0u, 14u, 15u, 16u, 255u, 256u, 257u, 271u, 5000u}) {
+    expected.push_back(std::string(size, 'a' + size % 26));
+    text += expected.back() + "\n";
+  }
+  expected.push_back(std::string(1000, 'z'));
+  text += expected.back();
+  std::stringstream is(text);
+  String line;
+  std::vector<std::string> lines;
+  while (ReadLine(is, line)) {
+    lines.emplace_back(line.Data(), line.Size());
+  }
+  EXPECT_EQ(lines, expected);
+  EXPECT_TRUE(is.eof());
+
+  std::stringstream empty("");
+  EXPECT_FALSE(ReadLine(empty, line));
+  EXPECT_TRUE(line.Empty());
+  std::stringstream newline("\n");
+  EXPECT_TRUE(ReadLine(newline, line));
+  EXPECT_TRUE(line.Empty());
+  EXPECT_FALSE(ReadLine(newline, line));
+}
+
+size_t OpenFdCount() {
+  size_t count = 0;
+  for (int fd = 0; fd < 1024; ++fd) {
+    count += fcntl(fd, F_GETFD) != -1;
+  }
+  return count;
+}
+
+TEST(Iostream, FromFileClosesOnError) {
+  size_t before = OpenFdCount();
+  // A directory opens and reports a size but fails to read.
+  EXPECT_THROW(String::FromFile("/tmp"), std::system_error);
+  EXPECT_EQ(OpenFdCount(), before);
+}
+
+TEST(Iostream, FromFile) {
+  char path[] = "/tmp/string_from_file_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  std::string text(100000, 'f');
+  std::ofstream(path) << text;
+  String s = String::FromFile(path);
+  EXPECT_EQ(s.Size(), text.size());
+  std::remove(path);
+  EXPECT_THROW(String::FromFile(path), std::system_error);
+}
+
+TEST(Comparison, Bytes) {
+  String prefix = "abc";
+  String longer = "abcd";
+  String high = "ab\xff";
+  String embedded(StringView("ab\0c", 4));
+  EXPECT_LT(prefix.Compare(longer), 0);
+  EXPECT_GT(longer.Compare(prefix), 0);
+  EXPECT_EQ(prefix.Compare("abc"), 0);
+  EXPECT_TRUE(longer < high);
+  EXPECT_TRUE(embedded < prefix);
+  EXPECT_TRUE(embedded != String("ab"));
+  EXPECT_TRUE(String() == String(""));
+  EXPECT_TRUE(String("zz") > String("zy"));
+}
+
+TEST(Hash, Consistent) {
+  std::hash<String> hasher;
+  std::hash<StringView> view_hasher;
+  std::unordered_map<size_t, int> seen;
+  for (size_t size = 0; size < 200; ++size) {
+    String s(size, 'h');
+    EXPECT_EQ(hasher(s), hasher(String(s)));
+    EXPECT_EQ(hasher(s), view_hasher(StringView(s)));
+    ++seen[hasher(s)];
+  }
+  EXPECT_EQ(seen.size(), 200u);
+  EXPECT_NE(hasher("ab"), hasher("ba"));
+}
+
+TEST(Hash, UnorderedMap) {
+  std::unordered_map<String, int> counts;
+  for (const char* word : {"a", "b", "a", "a long key past the local buffer",
+                           "a long key past the local buffer"}) {
+    ++counts[word];
+  }
+  EXPECT_EQ(counts.size(), 3u);
+  EXPECT_EQ(counts["a"], 2);
+  EXPECT_EQ(counts["a long key past the local buffer"], 2);
+}
+
+TEST(Interner, SameTextSameAtom) {
+  Interner interner;
+  Atom first = interner.Intern("field_name");
+  Atom second = interner.Intern(String("field_") + String("name"));
+  Atom other = interner.Intern("other");
+  EXPECT_TRUE(first == second);
+  EXPECT_TRUE(first != other);
+  EXPECT_TRUE(interner.Intern("") == Atom());
+  EXPECT_EQ(first.Hash(), std::hash<String>()(String("field_name")));
+  EXPECT_TRUE(first.ToString() == "field_name");
+  EXPECT_STREQ(first.Data(), "field_name");
+  EXPECT_EQ(interner.Size(), 2u);
+  String big(100000, 'b');
+  EXPECT_TRUE(interner.Intern(big).ToString() == big);
+  EXPECT_TRUE(Atom(String("global")) == Atom(StringView("global")));
+}
+
+TEST(Interner, Threads) {
+  Interner interner;
+  const int kThreads = 4;
+  const int kKeys = 1000;
+  std::vector<std::vector<Atom>> atoms(kThreads);
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kThreads; ++thread) {
+    threads.emplace_back([&, thread] {
+      for (int key = 0; key < kKeys; ++key) {
+        String text(static_cast<size_t>(key % 40 + 1), 'k');
+        text += String(std::to_string(key).c_str());
+        atoms[thread].push_back(interner.Intern(text));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(interner.Size(), static_cast<size_t>(kKeys));
+  for (int thread = 1; thread < kThreads; ++thread) {
+    EXPECT_TRUE(atoms[thread] == atoms[0]);
+  }
+}
+
+// Forwards to new/delete and keeps count of the bytes outstanding.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  size_t outstanding = 0;
+  size_t allocations = 0;
+
+ protected:
+  void* do_allocate(size_t bytes, size_t align) override {
+    outstanding += bytes;
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+  void do_deallocate(void* ptr, size_t bytes, size_t align) override {
+    outstanding -= bytes;
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+  }
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// CountingResource that throws std::bad_alloc once `budget` allocations
+// have been made.
+class ThrowingResource : public CountingResource {
+ public:
+  size_t budget = 0;
+
+ private:
+  void* do_allocate(size_t bytes, size_t align) override {
+    if (allocations == budget) {
+      throw std::bad_alloc();
+    }
+    return CountingResource::do_allocate(bytes, align);
+  }
+};
+
+TEST(Allocator, CopyAssignmentIsStrong) {
+  ThrowingResource resource;
+  resource.budget = 1;
+  {
+    String s(StringView("a heap string of thirty chars!"), &resource);
+    size_t capacity = s.Capacity();
+    String longer = s * 3;
+    EXPECT_THROW(s = longer, std::bad_alloc);
+    EXPECT_TRUE(s == "a heap string of thirty chars!");
+    EXPECT_EQ(s.Capacity(), capacity);
+    EXPECT_EQ(resource.outstanding, capacity + 1);
+
+    String inline_string(&resource);
+    EXPECT_THROW(inline_string = longer, std::bad_alloc);
+    EXPECT_TRUE(inline_string.Empty());
+    inline_string = String("inline");
+    EXPECT_TRUE(inline_string == "inline");
+  }
+  EXPECT_EQ(resource.outstanding, 0u);
+}
+
+TEST(Allocator, UsesResource) {
+  CountingResource resource;
+  {
+    String s(StringView("a string longer than the inline buffer"), &resource);
+    EXPECT_EQ(s.Resource(), &resource);
+    EXPECT_EQ(resource.outstanding, s.Capacity() + 1);
+    String moved = std::move(s);
+    EXPECT_EQ(moved.Resource(), &resource);
+    String copy = moved;
+    EXPECT_EQ(copy.Resource(), std::pmr::get_default_resource());
+    String arena_copy(copy, &resource);
+    EXPECT_TRUE(arena_copy == moved);
+    EXPECT_EQ(resource.allocations, 2u);
+  }
+  EXPECT_EQ(resource.outstanding, 0u);
+}
+
+TEST(Allocator, ShrinkToFitReleases) {
+  CountingResource resource;
+  String s(&resource);
+  s.Reserve(1000);
+  s += String("abcdefghijklmnopqrstuvwxyz");
+  EXPECT_EQ(resource.outstanding, 1001u);
+  s.ShrinkToFit();
+  EXPECT_EQ(s.Capacity(), 26u);
+  EXPECT_EQ(resource.outstanding, 27u);
+  s.Resize(5);
+  s.ShrinkToFit();
+  EXPECT_EQ(resource.outstanding, 0u);
+  EXPECT_TRUE(s == "abcde");
+}
+
+TEST(Allocator, GrowthPolicy) {
+  String exact(std::pmr::get_default_resource(), GrowthPolicy::kExact);
+  String half(std::pmr::get_default_resource(), GrowthPolicy::kOneAndHalf);
+  String twice;
+  for (int i = 0; i < 17; ++i) {
+    exact.PushBack('e');
+    half.PushBack('h');
+    twice.PushBack('d');
+  }
+  EXPECT_EQ(exact.Growth(), GrowthPolicy::kExact);
+  EXPECT_EQ(exact.Capacity(), 17u);
+  EXPECT_EQ(half.Capacity(), 22u);
+  EXPECT_EQ(twice.Capacity(), 30u);
+  EXPECT_EQ(exact.Resource(), std::pmr::get_default_resource());
+}
+
+TEST(Allocator, LayoutsKeepTheirResource) {
+  CountingResource resource;
+  {
+    String tagged(StringView("seven!!"), &resource);
+    String compact = "fifteen chars!!";
+    String heap(StringView("long enough to need the heap"), &resource);
+    EXPECT_EQ(tagged.Capacity(), 7u);
+    EXPECT_EQ(compact.Capacity(), 15u);
+    EXPECT_EQ(resource.allocations, 1u);
+
+    tagged.Swap(compact);
+    EXPECT_TRUE(tagged == "fifteen chars!!");
+    EXPECT_TRUE(compact == "seven!!");
+    EXPECT_EQ(compact.Resource(), &resource);
+    EXPECT_EQ(tagged.Resource(), std::pmr::get_default_resource());
+    compact.Swap(heap);
+    EXPECT_TRUE(compact == "long enough to need the heap");
+    EXPECT_TRUE(heap == "seven!!");
+    EXPECT_EQ(compact.Resource(), &resource);
+    EXPECT_EQ(heap.Resource(), &resource);
+
+    String moved = std::move(compact);
+    EXPECT_EQ(moved.Resource(), &resource);
+    EXPECT_EQ(compact.Resource(), &resource);
+    EXPECT_TRUE(compact.Empty());
+    compact += String("abc");
+    EXPECT_EQ(resource.allocations, 1u);
+    compact += String("defghij");
+    EXPECT_EQ(resource.allocations, 2u);
+  }
+  EXPECT_EQ(resource.outstanding, 0u);
+
+  // Only the default resource with kDouble gets 15 inline characters, so
+  // changing the policy can move a short string to the heap and back.
+  String s = "ten chars!";
+  s.SetGrowth(GrowthPolicy::kExact);
+  EXPECT_TRUE(s == "ten chars!");
+  EXPECT_EQ(s.Growth(), GrowthPolicy::kExact);
+  EXPECT_EQ(s.Capacity(), 15u);
+  s.Resize(3);
+  s.ShrinkToFit();
+  EXPECT_EQ(s.Capacity(), 7u);
+  s.SetGrowth(GrowthPolicy::kDouble);
+  EXPECT_EQ(s.Capacity(), 15u);
+  EXPECT_TRUE(s == "ten");
+}
+
+TEST(Allocator, MonotonicArena) {
+  char buffer[4096];
+  std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+  String s(&arena, GrowthPolicy::kExact);
+  for (int i = 0; i < 10; ++i) {
+    s += String("request-scoped ");
+  }
+  EXPECT_GE(s.Data(), buffer);
+  EXPECT_LT(s.Data(), buffer + sizeof(buffer));
+  EXPECT_EQ(s.Size(), 150u);
+}
+
+TEST(Repeat, MatchesNaive) {
+  for (size_t size : {1u, 2u, 3u, 7u, 16u, 33u}) {
+    String pattern;
+    std::string expected_pattern;
+    for (size_t i = 0; i < size; ++i) {
+      pattern.PushBack('a' + i);
+      expected_pattern.push_back('a' + i);
+    }
+    for (int n : {0, 1, 2, 5, 100}) {
+      std::string expected;
+      for (int i = 0; i < n; ++i) {
+        expected += expected_pattern;
+      }
+      EXPECT_TRUE(pattern * n == expected.c_str());
+      EXPECT_TRUE(pattern.Repeat(n) == expected.c_str());
+      String in_place = pattern;
+      in_place *= n;
+      EXPECT_TRUE(in_place == expected.c_str());
+    }
+  }
+  EXPECT_TRUE(String() * 10 == "");
+}
+
+TEST(Repeat, Errors) {
+  String s = "ab";
+  EXPECT_THROW(s * -1, std::invalid_argument);
+  EXPECT_THROW(s.Repeat(static_cast<size_t>(-1) / 2 + 1), std::length_error);
+  EXPECT_TRUE(s == "ab");
+}
+
+TEST(Pad, LeftRightFill) {
+  String s = "42";
+  s.PadLeft(5, "0");
+  EXPECT_TRUE(s == "00042");
+  s.PadRight(10, "-=");
+  EXPECT_TRUE(s == "00042-=-=-");
+  s.PadLeft(3);
+  EXPECT_TRUE(s == "00042-=-=-");
+  String row = "x";
+  row.PadLeft(4);
+  EXPECT_TRUE(row == "   x");
+  row.Fill("ab");
+  EXPECT_TRUE(row == "abab");
+  EXPECT_THROW(row.PadRight(10, ""), std::invalid_argument);
+  String wide(40, 'w');
+  wide.PadLeft(1000, "xyz");
+  EXPECT_EQ(wide.Size(), 1000u);
+  EXPECT_EQ(wide[959], 'z');
+  EXPECT_EQ(wide[960], 'w');
+}
+
+TEST(Pad, FillMayAliasSelf) {
+  // Small and heap-sized strings, each padded far enough to reallocate.
+  for (size_t size : {3, 40}) {
+    std::string base;
+    for (size_t i = 0; i < size; ++i) {
+      base += static_cast<char>('a' + i % 26);
+    }
+    String left(base.data());
+    left.PadLeft(size * 5, left);
+    std::string expected = (base + base + base + base).substr(0, size * 4);
+    EXPECT_TRUE(left == String((expected + base).data()));
+
+    String right(base.data());
+    right.PadRight(size * 5, StringView(right).Substr(1));
+    expected = base;
+    while (expected.size() < size * 5) {
+      expected += base.substr(1);
+    }
+    EXPECT_TRUE(right == String(expected.substr(0, size * 5).data()));
+
+    String fill(base.data());
+    fill.Fill(StringView(fill).Substr(1, 2));
+    expected.clear();
+    while (expected.size() < size) {
+      expected += base.substr(1, 2);
+    }
+    EXPECT_TRUE(fill == String(expected.substr(0, size).data()));
+  }
+}
+
+TEST(Utf8, Validate) {
+  EXPECT_TRUE(String("plain ascii").IsValidUtf8());
+  EXPECT_TRUE(String("\u043f\u0440\u0438\u0432\u0435\u0442 \u4e16\u754c \U0001F600")
+                  .IsValidUtf8());
+  const char* invalid[] = {"\xc0\xaf",         "\xe0\x80\xaf", "\xed\xa0\x80",
+                           "\xf4\x90\x80\x80", "\xf8\x88\x80\x80\x80",
+                           "\x80",             "\xe4\xb8",      "a\xff"};
+  for (const char* bad : invalid) {
+    EXPECT_FALSE(String(bad).IsValidUtf8()) << bad;
+    // The same error in the middle of a long run, across block boundaries.
+    for (size_t offset : {0u, 29u, 30u, 31u, 32u, 63u}) {
+      String s(offset, 'x');
+      s += String(bad);
+      s += String(70, 'y');
+      EXPECT_FALSE(s.IsValidUtf8()) << offset;
+    }
+  }
+}
+
+TEST(Utf8, ValidateMatchesDecode) {
+  std::mt19937 gen(45);
+  std::uniform_int_distribution<int> byte(0, 255);
+  const char* pieces[] = {"a", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80"};
+  for (int round = 0; round < 2000; ++round) {
+    String s;
+    for (int i = 0; i < 40; ++i) {
+      s += String(pieces[byte(gen) % 4]);
+    }
+    if (round % 2 == 1) {
+      s[byte(gen) % s.Size()] = static_cast<char>(byte(gen));
+    }
+    bool expected = true;
+    for (auto it = s.CodePoints().begin(); it != s.CodePoints().end(); ++it) {
+      if (*it == utf8::kReplacement) {
+        expected = false;
+      }
+    }
+    EXPECT_EQ(s.IsValidUtf8(), expected);
+  }
+}
+
+TEST(Utf8, CodePoints) {
+  String s = "a\u00e9\u20ac\U0001F600";
+  std::vector<char32_t> points(s.CodePoints().begin(), s.CodePoints().end());
+  std::vector<char32_t> expected{U'a', 0xE9, 0x20AC, 0x1F600};
+  EXPECT_EQ(points, expected);
+  EXPECT_EQ(s.CodePointCount(), 4u);
+  String long_text = s * 20;
+  EXPECT_EQ(long_text.CodePointCount(), 80u);
+  String broken = "x\xff\xe2\x82";
+  points.assign(broken.CodePoints().begin(), broken.CodePoints().end());
+  expected = {U'x', utf8::kReplacement, utf8::kReplacement, utf8::kReplacement};
+  EXPECT_EQ(points, expected);
+}
+
+TEST(Utf8, AsciiCase) {
+  String s = String("Hello, World! \u00c9t\u00e9 [@`{] ") * 5;
+  String lower = s;
+  lower.ToLowerAscii();
+  String upper = s;
+  upper.ToUpperAscii();
+  EXPECT_TRUE(lower ==
+              String("hello, world! \u00c9t\u00e9 [@`{] ") * 5);
+  EXPECT_TRUE(upper ==
+              String("HELLO, WORLD! \u00c9T\u00e9 [@`{] ") * 5);
+  EXPECT_TRUE(upper.IsValidUtf8());
+}
+
+TEST(Numbers, AppendInt) {
+  String s = "x=";
+  s.AppendInt(42).AppendInt(-7).AppendInt(0u);
+  EXPECT_TRUE(s == "x=42-70");
+  String edges;
+  edges.AppendInt(std::numeric_limits<int64_t>::min());
+  edges.PushBack(' ');
+  edges.AppendInt(std::numeric_limits<uint64_t>::max());
+  EXPECT_TRUE(edges == "-9223372036854775808 18446744073709551615");
+  EXPECT_EQ(edges.Size(), 41u);
+}
+
+TEST(Numbers, AppendDoubleRoundTrips) {
+  std::mt19937_64 gen(46);
+  for (int i = 0; i < 10000; ++i) {
+    uint64_t bits = gen();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    // Some from_chars versions (libstdc++ 11) report subnormals as
+    // out of range.
+    if (value != value || (!std::isnormal(value) && value != 0 &&
+                           !std::isinf(value))) {
+      continue;
+    }
+    String s;
+    s.AppendDouble(value);
+    EXPECT_EQ(s.ParseDouble(), value) << s;
+  }
+  String s;
+  s.AppendDouble(0.1).PushBack(',');
+  s.AppendDouble(-1e300).PushBack(',');
+  s.AppendDouble(-2.2250738585072014e-308);
+  EXPECT_TRUE(s == "0.1,-1e+300,-2.2250738585072014e-308");
+  for (double value : {0.0, -0.0, std::numeric_limits<double>::min(),
+                       std::numeric_limits<double>::max(),
+                       std::numeric_limits<double>::infinity()}) {
+    String text;
+    text.AppendDouble(value);
+    EXPECT_EQ(text.ParseDouble(), value) << text;
+  }
+}
+
+TEST(Numbers, Parse) {
+  EXPECT_EQ(String("-123").ParseInt(), -123);
+  EXPECT_EQ(String("255").ParseInt<uint8_t>(), 255);
+  EXPECT_THROW(String("256").ParseInt<uint8_t>(), std::out_of_range);
+  EXPECT_THROW(String("12a").ParseInt(), std::invalid_argument);
+  EXPECT_THROW(String("").ParseInt(), std::invalid_argument);
+  EXPECT_THROW(String(" 1").ParseInt(), std::invalid_argument);
+  EXPECT_EQ(String("2.5e-3").ParseDouble(), 2.5e-3);
+  EXPECT_THROW(String("1e999").ParseDouble(), std::out_of_range);
+  EXPECT_THROW(String("1.5x").ParseDouble(), std::invalid_argument);
+}
 
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
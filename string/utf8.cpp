@@ -0,0 +1,326 @@
+#include "utf8.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_X86 1
+#endif
+
+namespace utf8 {
+
+namespace {
+
+// Length of a well-formed sequence starting with a lead byte, 0 for bytes
+// that cannot start one (continuations, C0, C1, F5-FF).
+size_t SequenceLength(unsigned char lead) {
+  if (lead < 0x80) {
+    return 1;
+  }
+  if (lead < 0xC2) {
+    return 0;
+  }
+  if (lead < 0xE0) {
+    return 2;
+  }
+  if (lead < 0xF0) {
+    return 3;
+  }
+  if (lead < 0xF5) {
+    return 4;
+  }
+  return 0;
+}
+
+// Bounds of the second byte per Unicode table 3-7; later bytes are always
+// 80-BF.
+bool SecondByteValid(unsigned char lead, unsigned char second) {
+  unsigned char low = 0x80;
+  unsigned char high = 0xBF;
+  if (lead == 0xE0) {
+    low = 0xA0;
+  } else if (lead == 0xED) {
+    high = 0x9F;
+  } else if (lead == 0xF0) {
+    low = 0x90;
+  } else if (lead == 0xF4) {
+    high = 0x8F;
+  }
+  return second >= low && second <= high;
+}
+
+// Length of the well-formed sequence at bytes[0], 0 if it is ill-formed.
+size_t ValidSequence(const unsigned char* bytes, size_t size) {
+  size_t length = SequenceLength(bytes[0]);
+  if (length <= 1) {
+    return length;
+  }
+  if (length > size || !SecondByteValid(bytes[0], bytes[1])) {
+    return 0;
+  }
+  for (size_t iii = 2; iii < length; ++iii) {
+    if ((bytes[iii] & 0xC0) != 0x80) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+bool ScalarValidate(const unsigned char* bytes, size_t size) {
+  size_t pos = 0;
+  while (pos < size) {
+    if (bytes[pos] < 0x80) {
+      ++pos;
+      continue;
+    }
+    size_t length = ValidSequence(bytes + pos, size - pos);
+    if (length == 0) {
+      return false;
+    }
+    pos += length;
+  }
+  return true;
+}
+
+#ifdef UTF8_X86
+bool HasAvx2() {
+  static const bool kSupported = __builtin_cpu_supports("avx2");
+  return kSupported;
+}
+
+// The lookup algorithm of Keiser and Lemire, "Validating UTF-8 in less than
+// one instruction per byte" (2021). Each byte is classified together with
+// the byte before it by three 16-entry table lookups (high nibble of the
+// previous byte, its low nibble, high nibble of the current byte); the AND
+// of the three is nonzero exactly for the error kinds below. Third and
+// fourth bytes of long sequences are checked separately by looking two
+// and three bytes back.
+const uint8_t kTooShort = 1 << 0;  // Lead or ASCII followed by a lead/ASCII.
+const uint8_t kTooLong = 1 << 1;   // ASCII followed by a continuation.
+const uint8_t kOverlong3 = 1 << 2;
+const uint8_t kTooLarge = 1 << 3;
+const uint8_t kSurrogate = 1 << 4;
+const uint8_t kOverlong2 = 1 << 5;
+const uint8_t kTooLarge1000 = 1 << 6;
+const uint8_t kOverlong4 = 1 << 6;
+const uint8_t kTwoConts = 1 << 7;  // Continuation after a continuation.
+const uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+__attribute__((target("avx2"))) __m256i Table(
+    uint8_t v0, uint8_t v1, uint8_t v2, uint8_t v3, uint8_t v4, uint8_t v5,
+    uint8_t v6, uint8_t v7, uint8_t v8, uint8_t v9, uint8_t v10, uint8_t v11,
+    uint8_t v12, uint8_t v13, uint8_t v14, uint8_t v15) {
+  return _mm256_setr_epi8(v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11,
+                          v12, v13, v14, v15, v0, v1, v2, v3, v4, v5, v6, v7,
+                          v8, v9, v10, v11, v12, v13, v14, v15);
+}
+
+// The 32 bytes ending `shift` bytes before the end of `input`, taking the
+// first ones from the end of `previous`.
+template <int kShift>
+__attribute__((target("avx2"))) __m256i Previous(__m256i input,
+                                                 __m256i previous) {
+  __m256i straddle = _mm256_permute2x128_si256(previous, input, 0x21);
+  return _mm256_alignr_epi8(input, straddle, 16 - kShift);
+}
+
+__attribute__((target("avx2"))) __m256i HighNibble(__m256i bytes) {
+  return _mm256_and_si256(_mm256_srli_epi16(bytes, 4),
+                          _mm256_set1_epi8(0x0F));
+}
+
+struct Avx2Validator {
+  __m256i error;
+  __m256i previous;
+  // Nonzero where the last block ended inside a multi-byte sequence.
+  __m256i incomplete;
+  __m256i byte1_high;
+  __m256i byte1_low;
+  __m256i byte2_high;
+
+  __attribute__((target("avx2"))) Avx2Validator() {
+    error = _mm256_setzero_si256();
+    previous = _mm256_setzero_si256();
+    incomplete = _mm256_setzero_si256();
+    byte1_high = Table(kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+                       kTooLong, kTooLong, kTooLong, kTwoConts, kTwoConts,
+                       kTwoConts, kTwoConts, kTooShort | kOverlong2, kTooShort,
+                       kTooShort | kOverlong3 | kSurrogate,
+                       kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+    const uint8_t kLarge = kCarry | kTooLarge | kTooLarge1000;
+    byte1_low = Table(kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+                      kCarry | kOverlong2, kCarry, kCarry, kCarry | kTooLarge,
+                      kLarge, kLarge, kLarge, kLarge, kLarge, kLarge, kLarge,
+                      kLarge, kLarge | kSurrogate, kLarge, kLarge);
+    const uint8_t kCont = kTooLong | kOverlong2 | kTwoConts;
+    byte2_high = Table(kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+                       kTooShort, kTooShort, kTooShort,
+                       kCont | kOverlong3 | kTooLarge1000 | kOverlong4,
+                       kCont | kOverlong3 | kTooLarge,
+                       kCont | kSurrogate | kTooLarge,
+                       kCont | kSurrogate | kTooLarge, kTooShort, kTooShort,
+                       kTooShort, kTooShort);
+  }
+
+  __attribute__((target("avx2"))) void Step(__m256i input) {
+    if (_mm256_movemask_epi8(input) == 0) {
+      // All ASCII: only a sequence cut off by the previous block can fail.
+      error = _mm256_or_si256(error, incomplete);
+      previous = input;
+      return;
+    }
+    __m256i prev1 = Previous<1>(input, previous);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(byte1_high, HighNibble(prev1)),
+            _mm256_shuffle_epi8(byte1_low,
+                                _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+        _mm256_shuffle_epi8(byte2_high, HighNibble(input)));
+    // 111xxxxx two back or 1111xxxx three back require a continuation here.
+    __m256i third = _mm256_subs_epu8(Previous<2>(input, previous),
+                                     _mm256_set1_epi8(0xE0 - 0x80));
+    __m256i fourth = _mm256_subs_epu8(Previous<3>(input, previous),
+                                      _mm256_set1_epi8(0xF0 - 0x80));
+    __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth),
+                                             _mm256_set1_epi8(char(0x80)));
+    error = _mm256_or_si256(error, _mm256_xor_si256(must_continue, special));
+    // Leads in the last three bytes whose sequence runs past this block.
+    const __m256i kMaxValue = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, char(0xF0 - 1),
+        char(0xE0 - 1), char(0xC0 - 1));
+    incomplete = _mm256_subs_epu8(input, kMaxValue);
+    previous = input;
+  }
+};
+
+__attribute__((target("avx2"))) bool Avx2Validate(const char* data,
+                                                  size_t size) {
+  Avx2Validator validator;
+  size_t pos = 0;
+  for (; pos + 32 <= size; pos += 32) {
+    validator.Step(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos)));
+  }
+  if (pos < size) {
+    // Zero padding is ASCII, so a sequence truncated by the end of the
+    // input shows up as too short.
+    char tail[32] = {};
+    memcpy(tail, data + pos, size - pos);
+    validator.Step(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail)));
+  }
+  __m256i error = _mm256_or_si256(validator.error, validator.incomplete);
+  return _mm256_testz_si256(error, error) != 0;
+}
+
+__attribute__((target("avx2,popcnt"))) size_t Avx2CountCodePoints(
+    const char* data, size_t size) {
+  // Continuation bytes are 0x80-0xBF, i.e. -128..-65 as signed bytes.
+  const __m256i kLastContinuation = _mm256_set1_epi8(-65);
+  size_t count = 0;
+  size_t pos = 0;
+  for (; pos + 32 <= size; pos += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+    uint32_t leads = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpgt_epi8(block, kLastContinuation)));
+    count += _mm_popcnt_u32(leads);
+  }
+  for (; pos < size; ++pos) {
+    count += (static_cast<unsigned char>(data[pos]) & 0xC0) != 0x80;
+  }
+  return count;
+}
+
+// Adds `delta` to every byte in [first, last].
+__attribute__((target("avx2"))) void Avx2MapRange(char* data, size_t size,
+                                                  char first, char last,
+                                                  char delta) {
+  const __m256i kBelow = _mm256_set1_epi8(static_cast<char>(first - 1));
+  const __m256i kAbove = _mm256_set1_epi8(static_cast<char>(last + 1));
+  const __m256i kDelta = _mm256_set1_epi8(delta);
+  size_t pos = 0;
+  for (; pos + 32 <= size; pos += 32) {
+    __m256i* ptr = reinterpret_cast<__m256i*>(data + pos);
+    __m256i block = _mm256_loadu_si256(ptr);
+    // Bytes >= 0x80 are negative and so never inside the range.
+    __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi8(block, kBelow),
+                                      _mm256_cmpgt_epi8(kAbove, block));
+    _mm256_storeu_si256(
+        ptr, _mm256_add_epi8(block, _mm256_and_si256(inside, kDelta)));
+  }
+  for (; pos < size; ++pos) {
+    if (data[pos] >= first && data[pos] <= last) {
+      data[pos] = static_cast<char>(data[pos] + delta);
+    }
+  }
+}
+#endif
+
+void MapRange(char* data, size_t size, char first, char last, char delta) {
+#ifdef UTF8_X86
+  if (HasAvx2()) {
+    Avx2MapRange(data, size, first, last, delta);
+    return;
+  }
+#endif
+  for (size_t pos = 0; pos < size; ++pos) {
+    if (data[pos] >= first && data[pos] <= last) {
+      data[pos] = static_cast<char>(data[pos] + delta);
+    }
+  }
+}
+
+}  // namespace
+
+bool Validate(const char* data, size_t size) {
+#ifdef UTF8_X86
+  if (HasAvx2()) {
+    return Avx2Validate(data, size);
+  }
+#endif
+  return ScalarValidate(reinterpret_cast<const unsigned char*>(data), size);
+}
+
+size_t CountCodePoints(const char* data, size_t size) {
+#ifdef UTF8_X86
+  if (HasAvx2()) {
+    return Avx2CountCodePoints(data, size);
+  }
+#endif
+  size_t count = 0;
+  for (size_t pos = 0; pos < size; ++pos) {
+    count += (static_cast<unsigned char>(data[pos]) & 0xC0) != 0x80;
+  }
+  return count;
+}
+
+void ToLowerAscii(char* data, size_t size) {
+  MapRange(data, size, 'A', 'Z', 'a' - 'A');
+}
+
+void ToUpperAscii(char* data, size_t size) {
+  MapRange(data, size, 'a', 'z', 'A' - 'a');
+}
+
+char32_t Decode(const char* data, size_t size, size_t* length) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  size_t sequence = ValidSequence(bytes, size);
+  if (sequence == 0) {
+    *length = 1;
+    return kReplacement;
+  }
+  *length = sequence;
+  if (sequence == 1) {
+    return bytes[0];
+  }
+  // The lead keeps 7 - sequence payload bits, continuations keep 6 each.
+  char32_t code = bytes[0] & (0x7F >> sequence);
+  for (size_t iii = 1; iii < sequence; ++iii) {
+    code = (code << 6) | (bytes[iii] & 0x3F);
+  }
+  return code;
+}
+
+}  // namespace utf8
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+
+// UTF-8 over raw byte ranges, used by String. The bulk operations have
+// AVX2 versions picked at run time and process 32 bytes per step.
+namespace utf8 {
+
+const char32_t kReplacement = 0xFFFD;
+
+// Whether [data, data + size) is well-formed UTF-8: no overlong forms,
+// surrogates, code points past U+10FFFF or truncated sequences.
+bool Validate(const char* data, size_t size);
+
+// Number of code points, counting every byte that is not a continuation
+// byte (10xxxxxx). Exact for valid input.
+size_t CountCodePoints(const char* data, size_t size);
+
+// In-place ASCII case mapping; bytes outside A-Z / a-z, including every
+// byte of a multi-byte sequence, are left as they are.
+void ToLowerAscii(char* data, size_t size);
+void ToUpperAscii(char* data, size_t size);
+
+// Decodes the code point starting at data[0] (size > 0) and stores its
+// length in bytes in *length. An ill-formed sequence decodes to
+// kReplacement with *length = 1, so decoding always makes progress.
+char32_t Decode(const char* data, size_t size, size_t* length);
+
+// Forward range of the code points of a byte range, decoded lazily.
+class CodePointRange {
+ private:
+  const char* data_;
+  size_t size_;
+
+ public:
+  class Iterator {
+   private:
+    const char* pos_ = nullptr;
+    const char* end_ = nullptr;
+    char32_t value_ = 0;
+    size_t length_ = 0;
+
+    void Load() {
+      if (pos_ != end_) {
+        value_ = Decode(pos_, end_ - pos_, &length_);
+      }
+    }
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = char32_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char32_t*;
+    using reference = char32_t;
+
+    Iterator() = default;
+    Iterator(const char* pos, const char* end) : pos_(pos), end_(end) {
+      Load();
+    }
+    char32_t operator*() const { return value_; }
+    // Byte offset of the current code point within the range.
+    const char* Position() const { return pos_; }
+    Iterator& operator++() {
+      pos_ += length_;
+      Load();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+    bool operator==(const Iterator& other) const { return pos_ == other.pos_; }
+    bool operator!=(const Iterator& other) const { return pos_ != other.pos_; }
+  };
+
+  CodePointRange(const char* data, size_t size) : data_(data), size_(size) {}
+  Iterator begin() const { return Iterator(data_, data_ + size_); }
+  Iterator end() const { return Iterator(data_ + size_, data_ + size_); }
+};
+
+}  // namespace utf8